@@ -0,0 +1,57 @@
+#ifndef ABBREVIATED_KEY_H
+#define ABBREVIATED_KEY_H
+
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+// String priority with an 8-byte abbreviated key stored inline. The first 8 bytes of the
+// string are loaded big-endian (zero padded) so that unsigned integer order matches the
+// byte-wise lexicographic order used by std::string. Comparisons check the prefix first and
+// only dereference the string payloads when the prefixes tie, so most sift steps in
+// percolate_up/percolate_down never touch the heap-allocated characters.
+//
+// Use as ThreadedPriorityQueue<AbbreviatedKey<>> for an ascending queue, or with
+// std::greater<AbbreviatedKey<>> for a descending one.
+template <typename T = std::string>
+struct AbbreviatedKey {
+    uint64_t prefix = 0;
+    T value{};
+
+    AbbreviatedKey() = default;
+    AbbreviatedKey(T v) : prefix(abbreviate(std::string_view(v))), value(std::move(v)) {}
+
+    static inline uint64_t abbreviate(std::string_view s) noexcept {
+        uint64_t p = 0;
+
+        if (s.size() >= sizeof(uint64_t)) {
+            memcpy(&p, s.data(), sizeof(uint64_t));
+#if defined(__GNUC__) || defined(__clang__)
+            if constexpr (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+                p = __builtin_bswap64(p);
+            return p;
+#else
+            p = 0;
+#endif
+        }
+
+        for (size_t i = 0; i < sizeof(uint64_t); ++i)
+            p = (p << 8) | (i < s.size() ? uint64_t(static_cast<unsigned char>(s[i])) : 0);
+
+        return p;
+    }
+
+    inline bool operator<(const AbbreviatedKey& other) const {
+        if (prefix != other.prefix)
+            return prefix < other.prefix;
+        return std::string_view(value) < std::string_view(other.value);
+    }
+
+    inline bool operator>(const AbbreviatedKey& other) const {
+        return other < *this;
+    }
+};
+
+#endif // ABBREVIATED_KEY_H
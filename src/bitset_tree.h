@@ -0,0 +1,204 @@
+#ifndef BITSET_TREE_H
+#define BITSET_TREE_H
+
+#include "threaded_priority_queue.h"
+
+#include <type_traits>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <new>
+
+// Multi-level bitset over [0, n). Level 0 has one bit per position and every level above
+// has one bit per non-empty word of the level below, so with 64-bit words finding the
+// first or last set position touches log64(n) words: four for n = 2^24.
+class HierarchicalBitset {
+    std::vector<std::vector<uint64_t>> m_levels; // m_levels[0] is the leaf level
+
+    static inline size_t lowest_bit(uint64_t word) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+        return size_t(__builtin_ctzll(word));
+#else
+        size_t i = 0;
+        while (!(word & 1)) {
+            word >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    static inline size_t highest_bit(uint64_t word) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+        return size_t(63 - __builtin_clzll(word));
+#else
+        size_t i = 63;
+        while (!(word >> i))
+            --i;
+        return i;
+#endif
+    }
+public:
+    HierarchicalBitset() = default;
+
+    explicit HierarchicalBitset(size_t n) {
+        size_t words = (n + 63) / 64;
+        do {
+            m_levels.emplace_back(std::max<size_t>(words, 1), 0);
+            words = (words + 63) / 64;
+        } while (m_levels.back().size() > 1);
+    }
+
+    inline bool empty() const noexcept {
+        return !m_levels.back()[0];
+    }
+
+    inline bool test(size_t i) const noexcept {
+        return (m_levels[0][i / 64] >> (i % 64)) & 1;
+    }
+
+    inline void set(size_t i) noexcept {
+        for (std::vector<uint64_t>& level : m_levels) {
+            uint64_t& word = level[i / 64];
+            const bool was_empty = !word;
+
+            word |= uint64_t(1) << (i % 64);
+            if (!was_empty)
+                break;
+
+            i /= 64;
+        }
+    }
+
+    inline void reset(size_t i) noexcept {
+        for (std::vector<uint64_t>& level : m_levels) {
+            uint64_t& word = level[i / 64];
+
+            word &= ~(uint64_t(1) << (i % 64));
+            if (word)
+                break;
+
+            i /= 64;
+        }
+    }
+
+    // Lowest set position, the bitset must not be empty
+    inline size_t first() const noexcept {
+        size_t i = 0;
+        for (size_t level = m_levels.size(); level-- > 0;)
+            i = i * 64 + lowest_bit(m_levels[level][i]);
+        return i;
+    }
+
+    // Highest set position, the bitset must not be empty
+    inline size_t last() const noexcept {
+        size_t i = 0;
+        for (size_t level = m_levels.size(); level-- > 0;)
+            i = i * 64 + highest_bit(m_levels[level][i]);
+        return i;
+    }
+};
+
+// Engine for integral priorities in the bounded universe [0, 2^UniverseBits). A
+// HierarchicalBitset marks the keys present and a per-key counter holds duplicates, so
+// push is O(1) and pop is O(log64 U). Only std::less (min first) and std::greater (max
+// first) orderings are supported. Pushing a key outside the universe throws
+// std::out_of_range.
+//
+// Storage is allocated on first use: U / 8 bytes of bits plus 4 * U bytes of counters,
+// the latter zero-filled lazily by the OS.
+//
+//     ThreadedPriorityQueue<uint32_t, std::less<uint32_t>, BitsetTreeHeap<uint32_t>> queue;
+template <typename T, typename Comp = std::less<T>, unsigned UniverseBits = 24>
+class BitsetTreeHeap {
+    static_assert(std::is_integral_v<T>, "BitsetTreeHeap requires an integral priority type.");
+    static_assert(std::is_same_v<Comp, std::less<T>> || std::is_same_v<Comp, std::greater<T>>,
+        "BitsetTreeHeap supports std::less and std::greater orderings only.");
+    static_assert(UniverseBits > 0 && UniverseBits <= 32, "BitsetTreeHeap universe is out of range.");
+
+    static constexpr size_t universe = size_t(1) << UniverseBits;
+    static constexpr bool min_first = std::is_same_v<Comp, std::less<T>>;
+
+    struct FreeDeleter {
+        inline void operator()(uint32_t* p) const noexcept { std::free(p); }
+    };
+
+    HierarchicalBitset m_keys;
+    std::unique_ptr<uint32_t[], FreeDeleter> m_counts;
+    size_t m_size = 0;
+    T m_top{};
+
+    inline void allocate() {
+        m_keys = HierarchicalBitset(universe);
+        m_counts.reset(static_cast<uint32_t*>(std::calloc(universe, sizeof(uint32_t))));
+        if (!m_counts)
+            throw std::bad_alloc();
+    }
+public:
+    BitsetTreeHeap() = default;
+
+    inline bool empty() const noexcept { return !m_size; }
+    inline size_t size() const noexcept { return m_size; }
+    inline const T& top() const noexcept { return m_top; }
+
+    // Capacity does not depend on the element count
+    inline void reserve(size_t) noexcept {}
+
+    inline void push(const T& item) {
+        bool negative = false;
+        if constexpr (std::is_signed_v<T>)
+            negative = item < T(0);
+        if (negative || uint64_t(item) >= universe)
+            throw std::out_of_range("BitsetTreeHeap key outside the universe.");
+
+        if (!m_counts)
+            allocate();
+
+        const size_t key = size_t(item);
+        if (!m_counts[key]++)
+            m_keys.set(key);
+
+        if (!m_size++ || Comp{}(item, m_top))
+            m_top = item;
+    }
+
+    template <typename... Args>
+    inline void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    inline T pop() {
+        const T temp = m_top;
+        const size_t key = size_t(temp);
+
+        if (!--m_counts[key]) {
+            m_keys.reset(key);
+            if (!m_keys.empty())
+                m_top = T(min_first ? m_keys.first() : m_keys.last());
+        }
+
+        --m_size;
+        return temp;
+    }
+
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t) {
+        for (; first != last; ++first)
+            push(T(*first));
+    }
+
+    inline std::vector<T> drain_sorted(size_t) {
+        std::vector<T> out;
+        out.reserve(m_size);
+
+        while (m_size)
+            out.push_back(pop());
+
+        return out;
+    }
+};
+
+#endif // BITSET_TREE_H
@@ -0,0 +1,175 @@
+#ifndef DAG_SCHEDULER_H
+#define DAG_SCHEDULER_H
+
+#include "threaded_priority_queue.h"
+
+#include <functional>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Runs a dependency graph of tasks on N workers. Ready tasks are ordered by upward rank
+// (the task's cost plus the longest cost path to an exit task), so work on the critical
+// path is started first. Ranks are computed once per run, dependency counters are plain
+// atomics decremented on completion, and the tasks a completion makes ready are pushed
+// into the shared ThreadedPriorityQueue as one batch.
+class DagScheduler {
+public:
+    using TaskId = size_t;
+private:
+    struct Node {
+        std::function<void()> fn;
+        double cost = 1.0;
+        double rank = 0.0;
+        std::vector<TaskId> successors;
+        size_t dependencies = 0;
+    };
+
+    struct Ready {
+        double rank = 0.0;
+        TaskId id = 0;
+    };
+
+    struct HigherRank {
+        inline bool operator()(const Ready& a, const Ready& b) const noexcept {
+            if (a.rank != b.rank)
+                return a.rank > b.rank;
+            return a.id < b.id;
+        }
+    };
+
+    std::vector<Node> m_nodes;
+
+    // Kahn's algorithm, throws on cycles
+    inline std::vector<TaskId> topological_order() const {
+        std::vector<size_t> pending(m_nodes.size());
+        std::vector<TaskId> order;
+        order.reserve(m_nodes.size());
+
+        for (TaskId id = 0; id < m_nodes.size(); ++id) {
+            pending[id] = m_nodes[id].dependencies;
+            if (!pending[id])
+                order.push_back(id);
+        }
+
+        for (size_t i = 0; i < order.size(); ++i)
+            for (TaskId next : m_nodes[order[i]].successors)
+                if (!--pending[next])
+                    order.push_back(next);
+
+        if (order.size() != m_nodes.size())
+            throw std::invalid_argument("DagScheduler graph contains a cycle.");
+
+        return order;
+    }
+
+    inline void compute_ranks(const std::vector<TaskId>& order) {
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            Node& node = m_nodes[*it];
+
+            double longest = 0.0;
+            for (TaskId next : node.successors)
+                longest = std::max(longest, m_nodes[next].rank);
+
+            node.rank = node.cost + longest;
+        }
+    }
+public:
+    DagScheduler() = default;
+
+    inline TaskId add_task(std::function<void()> fn, double cost = 1.0) {
+        m_nodes.push_back(Node{std::move(fn), cost, 0.0, {}, 0});
+        return m_nodes.size() - 1;
+    }
+
+    // `after` may only start once `before` has finished
+    inline void add_dependency(TaskId before, TaskId after) {
+        if (before >= m_nodes.size() || after >= m_nodes.size())
+            throw std::out_of_range("DagScheduler task id out of range.");
+
+        m_nodes[before].successors.push_back(after);
+        ++m_nodes[after].dependencies;
+    }
+
+    inline size_t size() const noexcept {
+        return m_nodes.size();
+    }
+
+    // Upward rank from the last run()
+    inline double rank(TaskId id) const {
+        return m_nodes.at(id).rank;
+    }
+
+    // Runs every task once and blocks until they finish. Tasks depending on a task that
+    // threw never run, and the first exception is rethrown here after the workers join.
+    inline void run(size_t workers) {
+        if (m_nodes.empty())
+            return;
+
+        compute_ranks(topological_order());
+
+        const size_t n = m_nodes.size();
+        std::unique_ptr<std::atomic<size_t>[]> remaining(new std::atomic<size_t>[n]);
+        std::vector<Ready> sources;
+
+        for (TaskId id = 0; id < n; ++id) {
+            remaining[id].store(m_nodes[id].dependencies, std::memory_order_relaxed);
+            if (!m_nodes[id].dependencies)
+                sources.push_back(Ready{m_nodes[id].rank, id});
+        }
+
+        ThreadedPriorityQueue<Ready, HigherRank> ready(n);
+        std::atomic<size_t> completed{0};
+        std::exception_ptr failure;
+        std::mutex failure_mutex;
+
+        ready.push_bulk(sources.begin(), sources.end());
+
+        auto worker = [&] {
+            std::vector<Ready> batch;
+
+            while (std::optional<Ready> task = ready.wait_nonempty_pop()) {
+                const Node& node = m_nodes[task->id];
+
+                try {
+                    node.fn();
+                } catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock(failure_mutex);
+                        if (!failure)
+                            failure = std::current_exception();
+                    }
+                    ready.done();
+                    continue;
+                }
+
+                batch.clear();
+                for (TaskId next : node.successors)
+                    if (remaining[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        batch.push_back(Ready{m_nodes[next].rank, next});
+
+                if (!batch.empty())
+                    ready.push_bulk(batch.begin(), batch.end());
+
+                if (completed.fetch_add(1, std::memory_order_acq_rel) + 1 == n)
+                    ready.done();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::max<size_t>(workers, 1); ++i)
+            threads.emplace_back(worker);
+
+        worker(); // The calling thread works too
+        for (std::thread& thread : threads)
+            thread.join();
+
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+};
+
+#endif // DAG_SCHEDULER_H
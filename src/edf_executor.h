@@ -0,0 +1,219 @@
+#ifndef EDF_EXECUTOR_H
+#define EDF_EXECUTOR_H
+
+#include "threaded_priority_queue.h"
+
+#include <functional>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <array>
+#include <memory>
+
+// What a worker does with a task whose deadline has already passed when it is dequeued
+enum class EDFLatePolicy {
+    Run,    // Run it anyway and count the miss
+    Drop,   // Discard it without running
+    Demote  // Requeue it behind every task that can still meet its deadline
+};
+
+// Plain copy of one worker's counters. Histogram bucket 0 counts values below 1us and
+// bucket i counts values in [2^(i-1), 2^i) microseconds; the last bucket is open ended.
+struct EDFWorkerStats {
+    static constexpr size_t buckets = 32;
+
+    uint64_t completed = 0, missed = 0, dropped = 0, demoted = 0;
+    std::array<uint64_t, buckets> slack_histogram{};    // Deadline minus finish time, on-time tasks
+    std::array<uint64_t, buckets> lateness_histogram{}; // Finish time minus deadline, late tasks
+};
+
+// Earliest-deadline-first executor. Released tasks wait in a ThreadedPriorityQueue keyed
+// by deadline and N workers pull from it with wait_nonempty_pop(). Tasks with a future
+// release time are held by a timer thread that sleeps with a timed wait until the next
+// release and then moves them into the ready queue.
+class EDFExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+private:
+    struct Task {
+        std::function<void()> fn;
+        Clock::time_point deadline{}, release{};
+        bool demoted = false;
+    };
+
+    struct EarlierDeadline {
+        inline bool operator()(const Task& a, const Task& b) const noexcept {
+            if (a.demoted != b.demoted)
+                return !a.demoted;
+            return a.deadline < b.deadline;
+        }
+    };
+
+    struct EarlierRelease {
+        inline bool operator()(const Task& a, const Task& b) const noexcept {
+            return a.release < b.release;
+        }
+    };
+
+    struct WorkerCounters {
+        std::atomic<uint64_t> completed{0}, missed{0}, dropped{0}, demoted{0};
+        std::array<std::atomic<uint64_t>, EDFWorkerStats::buckets> slack{}, lateness{};
+    };
+
+    ThreadedPriorityQueue<Task, EarlierDeadline> m_ready;
+    EDFLatePolicy m_policy;
+
+    // Tasks not yet released, owned by the timer thread
+    BinaryHeap<Task, EarlierRelease> m_pending;
+    std::condition_variable m_pendingCondition;
+    std::mutex m_pendingMutex;
+    bool m_isStopping = false;
+
+    std::vector<std::unique_ptr<WorkerCounters>> m_counters;
+    std::vector<std::thread> m_workers;
+    std::thread m_timer;
+
+    static inline size_t bucket_of(Clock::duration d) noexcept {
+        uint64_t us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+        size_t bucket = 0;
+        while (us && bucket + 1 < EDFWorkerStats::buckets) {
+            us >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    inline void timer_loop() {
+        std::unique_lock<std::mutex> lock(m_pendingMutex);
+
+        while (true) {
+            if (m_pending.empty()) {
+                if (m_isStopping)
+                    break;
+
+                m_pendingCondition.wait(lock);
+                continue;
+            }
+
+            // Sleep until the earliest release; a new earlier task or shutdown wakes us early
+            const Clock::time_point next = m_pending.top().release;
+            if (Clock::now() < next) {
+                m_pendingCondition.wait_until(lock, next);
+                continue;
+            }
+
+            while (!m_pending.empty() && m_pending.top().release <= Clock::now())
+                m_ready.push(m_pending.pop());
+        }
+
+        lock.unlock();
+        m_ready.done();
+    }
+
+    inline void worker_loop(WorkerCounters& counters) {
+        while (std::optional<Task> task = m_ready.wait_nonempty_pop()) {
+            const Clock::time_point start = Clock::now();
+
+            if (start > task->deadline && !task->demoted) {
+                if (m_policy == EDFLatePolicy::Drop) {
+                    counters.dropped.fetch_add(1, std::memory_order_relaxed);
+                    counters.missed.fetch_add(1, std::memory_order_relaxed);
+                    counters.lateness[bucket_of(start - task->deadline)].fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                if (m_policy == EDFLatePolicy::Demote) {
+                    counters.demoted.fetch_add(1, std::memory_order_relaxed);
+                    task->demoted = true;
+                    m_ready.push(std::move(*task));
+                    continue;
+                }
+            }
+
+            task->fn();
+
+            const Clock::time_point finish = Clock::now();
+            counters.completed.fetch_add(1, std::memory_order_relaxed);
+
+            if (finish > task->deadline) {
+                counters.missed.fetch_add(1, std::memory_order_relaxed);
+                counters.lateness[bucket_of(finish - task->deadline)].fetch_add(1, std::memory_order_relaxed);
+            } else
+                counters.slack[bucket_of(task->deadline - finish)].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+public:
+    EDFExecutor(size_t workers, EDFLatePolicy policy = EDFLatePolicy::Run) : m_policy(policy) {
+        if (!workers)
+            workers = 1;
+
+        for (size_t i = 0; i < workers; ++i)
+            m_counters.push_back(std::make_unique<WorkerCounters>());
+
+        m_timer = std::thread([this] { timer_loop(); });
+        for (size_t i = 0; i < workers; ++i)
+            m_workers.emplace_back([this, i] { worker_loop(*m_counters[i]); });
+    }
+
+    EDFExecutor(const EDFExecutor&) = delete;
+    EDFExecutor& operator=(const EDFExecutor&) = delete;
+
+    ~EDFExecutor() {
+        shutdown();
+    }
+
+    // Queues fn to run by `deadline`, not before `release`
+    inline void submit(std::function<void()> fn, Clock::time_point deadline, Clock::time_point release = Clock::time_point{}) {
+        Task task{std::move(fn), deadline, release, false};
+
+        if (release <= Clock::now()) {
+            m_ready.push(std::move(task));
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            m_pending.push(std::move(task));
+        }
+        m_pendingCondition.notify_one();
+    }
+
+    // Releases and runs every queued task, then joins the threads
+    inline void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            if (m_isStopping)
+                return;
+            m_isStopping = true;
+        }
+        m_pendingCondition.notify_one();
+
+        m_timer.join();
+        for (std::thread& worker : m_workers)
+            worker.join();
+    }
+
+    inline size_t workers() const noexcept {
+        return m_counters.size();
+    }
+
+    inline EDFWorkerStats stats(size_t worker) const {
+        const WorkerCounters& counters = *m_counters.at(worker);
+        EDFWorkerStats out;
+
+        out.completed = counters.completed.load(std::memory_order_relaxed);
+        out.missed = counters.missed.load(std::memory_order_relaxed);
+        out.dropped = counters.dropped.load(std::memory_order_relaxed);
+        out.demoted = counters.demoted.load(std::memory_order_relaxed);
+
+        for (size_t i = 0; i < EDFWorkerStats::buckets; ++i) {
+            out.slack_histogram[i] = counters.slack[i].load(std::memory_order_relaxed);
+            out.lateness_histogram[i] = counters.lateness[i].load(std::memory_order_relaxed);
+        }
+
+        return out;
+    }
+};
+
+#endif // EDF_EXECUTOR_H
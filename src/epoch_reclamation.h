@@ -0,0 +1,184 @@
+#ifndef EPOCH_RECLAMATION_H
+#define EPOCH_RECLAMATION_H
+
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <deque>
+
+// Epoch-based memory reclamation for lock-free readers. A reader pins the current epoch
+// before loading shared pointers and unpins when done. Writers retire objects once they
+// are unreachable, tagged with the epoch at retirement, and an object is freed only when
+// every pinned reader entered an epoch later than its tag, since such readers can no
+// longer reach it.
+//
+// Each collection turns the objects retired since the previous one into a bucket tagged
+// with their newest epoch and frees whole buckets from the oldest on, so a lagging reader
+// costs one comparison per collection instead of a rescan of everything retired.
+//
+// Retiring is lock-free and collecting never blocks (a collection already running makes
+// others return), pinning is wait-free while one of the max_pins slots is available.
+class EpochDomain {
+public:
+    static constexpr size_t max_pins = 64;
+private:
+    struct Retired {
+        Retired* next;
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    struct Bucket {
+        Retired* list;
+        uint64_t epoch; // Newest epoch in list
+    };
+
+    static constexpr size_t collect_interval = 64;
+
+    std::atomic<uint64_t> m_epoch{1};
+    std::atomic<uint64_t> m_pins[max_pins]; // 0 when free, the pinned epoch otherwise
+    std::atomic<Retired*> m_retired{nullptr}; // Retired since the last collection
+    std::atomic<size_t> m_sinceCollect{0};
+
+    std::atomic<bool> m_collecting{false};
+    std::deque<Bucket> m_buckets; // Oldest first, owned by the running collection
+
+    static inline void free_list(Retired* list) {
+        while (list) {
+            Retired* next = list->next;
+            list->deleter(list->ptr);
+            delete list;
+            list = next;
+        }
+    }
+public:
+    // Keeps the epoch pinned for its lifetime
+    class Guard {
+        friend class EpochDomain;
+        EpochDomain* m_domain = nullptr;
+        size_t m_slot = 0;
+
+        Guard(EpochDomain* domain, size_t slot) : m_domain(domain), m_slot(slot) {}
+    public:
+        Guard() = default;
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        Guard(Guard&& other) noexcept : m_domain(other.m_domain), m_slot(other.m_slot) {
+            other.m_domain = nullptr;
+        }
+
+        Guard& operator=(Guard&& other) noexcept {
+            if (this != &other) {
+                release();
+                m_domain = other.m_domain;
+                m_slot = other.m_slot;
+                other.m_domain = nullptr;
+            }
+            return *this;
+        }
+
+        ~Guard() {
+            release();
+        }
+
+        inline void release() noexcept {
+            if (m_domain)
+                m_domain->m_pins[m_slot].store(0);
+            m_domain = nullptr;
+        }
+    };
+
+    EpochDomain() {
+        for (std::atomic<uint64_t>& pin : m_pins)
+            pin.store(0, std::memory_order_relaxed);
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Frees everything still retired, no reader may be pinned anymore
+    ~EpochDomain() {
+        for (const Bucket& bucket : m_buckets)
+            free_list(bucket.list);
+        free_list(m_retired.exchange(nullptr));
+    }
+
+    inline Guard pin() noexcept {
+        const size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % max_pins;
+
+        while (true) {
+            for (size_t i = 0; i < max_pins; ++i) {
+                const size_t slot = (start + i) % max_pins;
+                uint64_t expected = 0;
+
+                if (m_pins[slot].compare_exchange_strong(expected, m_epoch.load()))
+                    return Guard(this, slot);
+            }
+
+            std::this_thread::yield(); // Every slot is pinned
+        }
+    }
+
+    // Schedules ptr for deletion once no pinned reader can still reach it
+    inline void retire(void* ptr, void (*deleter)(void*)) {
+        Retired* node = new Retired{nullptr, ptr, deleter, m_epoch.load()};
+        node->next = m_retired.load();
+        while (!m_retired.compare_exchange_weak(node->next, node)) {}
+
+        if (m_sinceCollect.fetch_add(1) + 1 >= collect_interval) {
+            m_sinceCollect.store(0);
+            collect();
+        }
+    }
+
+    template <typename U>
+    inline void retire(U* ptr) {
+        retire(const_cast<void*>(static_cast<const void*>(ptr)), [](void* p) { delete static_cast<U*>(p); });
+    }
+
+    // Advances the epoch and frees retired objects older than every pinned reader
+    inline void collect() {
+        if (m_collecting.exchange(true, std::memory_order_acquire))
+            return; // Another thread is collecting
+
+        m_epoch.fetch_add(1);
+
+        // Everything retired since the last collection becomes one bucket
+        if (Retired* list = m_retired.exchange(nullptr)) {
+            uint64_t newest = 0;
+            for (const Retired* node = list; node; node = node->next)
+                newest = std::max(newest, node->epoch);
+
+            try {
+                m_buckets.push_back(Bucket{list, newest});
+            } catch (...) {
+                // Hand the list back, the next collection retries
+                Retired* tail = list;
+                while (tail->next)
+                    tail = tail->next;
+                tail->next = m_retired.load();
+                while (!m_retired.compare_exchange_weak(tail->next, list)) {}
+            }
+        }
+
+        uint64_t oldest = UINT64_MAX;
+        for (const std::atomic<uint64_t>& pin : m_pins) {
+            const uint64_t epoch = pin.load();
+            if (epoch && epoch < oldest)
+                oldest = epoch;
+        }
+
+        while (!m_buckets.empty() && m_buckets.front().epoch < oldest) {
+            free_list(m_buckets.front().list);
+            m_buckets.pop_front();
+        }
+
+        m_collecting.store(false, std::memory_order_release);
+    }
+};
+
+#endif // EPOCH_RECLAMATION_H
@@ -0,0 +1,106 @@
+#ifndef HUGE_PAGE_STORAGE_H
+#define HUGE_PAGE_STORAGE_H
+
+#include <cstdint>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Storage policy backing BinaryHeap's array with huge pages, for very large queues whose
+// traversals would otherwise thrash the TLB. Memory comes from the hugetlbfs pool
+// (MAP_HUGETLB) when pages are reserved there, else from an ordinary 2 MiB-aligned mapping
+// advised with MADV_HUGEPAGE so transparent huge pages can back it.
+//
+// With prefault every page is touched at allocation time, and with lock it is also
+// mlock()ed, so pops never take page faults. Locking is best effort: past RLIMIT_MEMLOCK
+// the memory stays prefaulted but swappable. Capacity always grows by whole huge pages,
+// but reserving the full capacity up front keeps regrowth (which allocates, copies and
+// faults a new array) off the hot path entirely:
+//
+//     using Heap = BinaryHeap<Order, ByPrice, HugePageStorage>;
+//     ThreadedPriorityQueue<Order, ByPrice, Heap> queue(std::in_place, HugePageStorage(true, true), 50'000'000);
+class HugePageStorage {
+public:
+    static constexpr size_t granularity = size_t(2) << 20; // Growth fills whole huge pages
+private:
+    static constexpr size_t huge_page = granularity;
+
+    bool m_prefault = false;
+    bool m_lock = false;
+
+    static inline size_t round_to_huge_pages(size_t bytes) noexcept {
+        return (bytes + huge_page - 1) / huge_page * huge_page;
+    }
+
+#if defined(__linux__)
+    // Ordinary anonymous mapping trimmed to a huge-page boundary
+    static inline void* map_aligned(size_t length) {
+        const size_t padded = length + huge_page;
+        void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            throw std::bad_alloc();
+
+        const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        const uintptr_t aligned = (start + huge_page - 1) & ~uintptr_t(huge_page - 1);
+
+        if (aligned > start)
+            munmap(raw, aligned - start);
+        if (start + padded > aligned + length)
+            munmap(reinterpret_cast<void*>(aligned + length), start + padded - aligned - length);
+
+        void* ptr = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+        return ptr;
+    }
+#endif
+public:
+    HugePageStorage() = default;
+    explicit HugePageStorage(bool prefault, bool lock = false) : m_prefault(prefault || lock), m_lock(lock) {}
+
+#if defined(__linux__)
+    inline void* allocate(size_t bytes, size_t alignment) {
+        if (alignment > huge_page)
+            throw std::bad_alloc(); // Mappings are only huge-page aligned
+
+        const size_t length = round_to_huge_pages(bytes);
+        void* ptr = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+        ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (ptr == MAP_FAILED)
+            ptr = map_aligned(length);
+
+        if (m_prefault) {
+            const size_t page = size_t(sysconf(_SC_PAGESIZE));
+            volatile char* bytes_ptr = static_cast<volatile char*>(ptr);
+            for (size_t offset = 0; offset < length; offset += page)
+                bytes_ptr[offset] = 0;
+        }
+
+        if (m_lock)
+            mlock(ptr, length);
+
+        return ptr;
+    }
+
+    inline void deallocate(void* ptr, size_t bytes, size_t) noexcept {
+        munmap(ptr, round_to_huge_pages(bytes)); // Also drops any lock
+    }
+#else
+    inline void* allocate(size_t bytes, size_t alignment) {
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    inline void deallocate(void* ptr, size_t, size_t alignment) noexcept {
+        ::operator delete(ptr, std::align_val_t(alignment));
+    }
+#endif
+};
+
+#endif // HUGE_PAGE_STORAGE_H
@@ -0,0 +1,257 @@
+#ifndef INDIRECT_HEAP_H
+#define INDIRECT_HEAP_H
+
+#include "threaded_priority_queue.h"
+#include "packed_key.h"
+
+#include <type_traits>
+#include <stdexcept>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <new>
+
+// Extracts the priority of KeyedItem-style elements
+struct KeyMember {
+    template <typename U>
+    inline auto operator()(const U& item) const noexcept -> decltype(item.key) {
+        return item.key;
+    }
+};
+
+// Engine for large elements. Elements are placed once in a pooled slab and never move
+// again; the heap itself only holds (key, slot index) pairs, so sifting costs the same no
+// matter how big the payload is. A pop moves the element out of its slot exactly once and
+// the slot is reused by later pushes.
+//
+// Comp orders the keys extracted with KeyOf (T::key by default), not whole elements.
+//
+//     using Engine = IndirectHeap<KeyedItem<uint64_t, Frame>, std::less<>>;
+//     ThreadedPriorityQueue<KeyedItem<uint64_t, Frame>, std::less<>, Engine> queue;
+template <typename T, typename Comp = std::less<>, typename KeyOf = KeyMember>
+class IndirectHeap {
+    using Key = std::decay_t<decltype(KeyOf{}(std::declval<const T&>()))>;
+
+    struct Entry {
+        Key key;
+        uint32_t slot;
+    };
+
+    struct EntryOrder {
+        inline bool operator()(const Entry& a, const Entry& b) const noexcept {
+            return Comp{}(a.key, b.key);
+        }
+    };
+
+    struct Slot {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    static constexpr size_t block_slots = 1024;
+
+    BinaryHeap<Entry, EntryOrder> m_index;
+    std::vector<std::unique_ptr<Slot[]>> m_blocks; // Fixed-size blocks, slots never move
+    std::vector<uint32_t> m_free;
+    size_t m_slots = 0; // Slots handed out so far, free or live
+
+    inline T* slot(uint32_t index) noexcept {
+        return std::launder(reinterpret_cast<T*>(m_blocks[index / block_slots][index % block_slots].bytes));
+    }
+
+    inline const T* slot(uint32_t index) const noexcept {
+        return std::launder(reinterpret_cast<const T*>(m_blocks[index / block_slots][index % block_slots].bytes));
+    }
+
+    inline uint32_t acquire_slot() {
+        if (!m_free.empty()) {
+            const uint32_t index = m_free.back();
+            m_free.pop_back();
+            return index;
+        }
+
+        if (m_slots >= UINT32_MAX)
+            throw std::length_error("priority queue capacity limit reached.");
+        if (m_slots == m_blocks.size() * block_slots)
+            m_blocks.push_back(std::make_unique<Slot[]>(block_slots));
+
+        return uint32_t(m_slots++);
+    }
+
+    template <typename... Args>
+    inline Entry place(Args&&... args) {
+        const uint32_t index = acquire_slot();
+
+        try {
+            const T* item = new (slot(index)) T(std::forward<Args>(args)...);
+            return Entry{KeyOf{}(*item), index};
+        } catch (...) {
+            m_free.push_back(index);
+            throw;
+        }
+    }
+
+    // Moves the element out and returns its slot to the pool
+    inline T take(uint32_t index) {
+        T* item = slot(index);
+        T temp = std::move(*item);
+        item->~T();
+        m_free.push_back(index);
+        return temp;
+    }
+
+    inline void destroy_live() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            std::vector<bool> free(m_slots, false);
+            for (uint32_t index : m_free)
+                free[index] = true;
+
+            for (size_t index = 0; index < m_slots; ++index)
+                if (!free[index])
+                    slot(uint32_t(index))->~T();
+        }
+    }
+public:
+    IndirectHeap() = default;
+
+    IndirectHeap(const IndirectHeap&) = delete;
+    IndirectHeap& operator=(const IndirectHeap&) = delete;
+
+    ~IndirectHeap() {
+        destroy_live();
+    }
+
+    inline bool empty() const noexcept { return m_index.empty(); }
+    inline size_t size() const noexcept { return m_index.size(); }
+    inline const T& top() const noexcept { return *slot(m_index.top().slot); }
+
+    inline void reserve(size_t cap) {
+        m_index.reserve(cap);
+        m_blocks.reserve((cap + block_slots - 1) / block_slots);
+        while (m_blocks.size() * block_slots < cap)
+            m_blocks.push_back(std::make_unique<Slot[]>(block_slots));
+    }
+
+    // Slab blocks are zeroed when allocated, so the warmup only has the index left to touch
+    inline void reserve(size_t cap, const WarmupPolicy& warmup) {
+        reserve(cap);
+        m_index.reserve(cap, warmup);
+    }
+
+    // Destroys every element, the slab and index keep their capacity
+    inline void clear() {
+        destroy_live();
+        m_index.clear();
+        m_free.clear();
+        m_slots = 0;
+    }
+
+    // Growth policy of the index array, the slab grows one block at a time
+    inline void set_capacity_policy(const CapacityPolicy& policy) noexcept { m_index.set_capacity_policy(policy); }
+
+    // Bytes held by the slab and the index
+    inline size_t memory_usage() const noexcept {
+        return m_blocks.size() * block_slots * sizeof(Slot) + m_free.capacity() * sizeof(uint32_t) + m_index.memory_usage();
+    }
+
+    inline void push(const T& item) {
+        emplace(item);
+    }
+
+    inline void push(T&& item) {
+        emplace(std::move(item));
+    }
+
+    template <typename... Args>
+    inline void emplace(Args&&... args) {
+        const Entry entry = place(std::forward<Args>(args)...);
+
+        try {
+            m_index.push(entry);
+        } catch (...) {
+            take(entry.slot);
+            throw;
+        }
+    }
+
+    inline T pop() {
+        return take(m_index.pop().slot);
+    }
+
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t threads) {
+        std::vector<Entry> entries;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>)
+            entries.reserve(size_t(std::distance(first, last)));
+
+        try {
+            for (; first != last; ++first)
+                entries.push_back(place(*first));
+            m_index.push_bulk(entries.begin(), entries.end(), threads);
+        } catch (...) {
+            for (const Entry& entry : entries)
+                take(entry.slot);
+            throw;
+        }
+    }
+
+    // Sorts only the small index entries, then moves each element out once
+    inline std::vector<T> drain_sorted(size_t threads) {
+        const std::vector<Entry> entries = m_index.drain_sorted(threads);
+
+        std::vector<T> out;
+        out.reserve(entries.size());
+        for (const Entry& entry : entries)
+            out.push_back(take(entry.slot));
+
+        return out;
+    }
+};
+
+// Elements with a T::key member that KeyMember can extract
+template <typename T, typename = void>
+struct has_key_member : std::false_type {};
+
+template <typename T>
+struct has_key_member<T, std::void_t<decltype(KeyMember{}(std::declval<const T&>()))>> : std::true_type {};
+
+// Elements whose operator< and operator> compare T::key alone, so ordering the keys orders
+// the elements. Opt in by specializing for such types; a type that merely has a key member
+// may order by other fields.
+template <typename T>
+struct orders_by_key : std::false_type {};
+
+template <typename Key, typename Payload>
+struct orders_by_key<KeyedItem<Key, Payload>> : std::true_type {};
+
+// Key ordering equivalent to an element ordering, void when there is none
+template <typename Comp>
+struct key_order_of { using type = void; };
+
+template <typename T>
+struct key_order_of<std::less<T>> { using type = std::less<>; };
+
+template <typename T>
+struct key_order_of<std::greater<T>> { using type = std::greater<>; };
+
+template <typename T, typename Comp>
+struct prefers_indirect_heap : std::bool_constant<has_key_member<T>::value && orders_by_key<T>::value
+    && !std::is_void_v<typename key_order_of<Comp>::type>
+    && (sizeof(T) > 64 || (!std::is_trivially_copyable_v<T> && sizeof(T) > 32))> {};
+
+template <typename T, typename Comp, bool Indirect = prefers_indirect_heap<T, Comp>::value>
+struct auto_heap_select { using type = BinaryHeap<T, Comp>; };
+
+template <typename T, typename Comp>
+struct auto_heap_select<T, Comp, true> { using type = IndirectHeap<T, typename key_order_of<Comp>::type>; };
+
+// Picks the engine at compile time: IndirectHeap for KeyedItem elements (or types opting in
+// through orders_by_key) larger than a cache line (or half of one when moves are not plain
+// copies), BinaryHeap otherwise, where indirection would cost more than moving the element.
+// The ordering must be std::less or std::greater so it can be applied to the keys.
+//
+//     ThreadedPriorityQueue<KeyedItem<uint64_t, Frame>, std::less<KeyedItem<uint64_t, Frame>>,
+//                           AutoHeap<KeyedItem<uint64_t, Frame>>> queue;
+template <typename T, typename Comp = std::less<T>>
+using AutoHeap = typename auto_heap_select<T, Comp>::type;
+
+#endif // INDIRECT_HEAP_H
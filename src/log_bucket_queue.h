@@ -0,0 +1,154 @@
+#ifndef LOG_BUCKET_QUEUE_H
+#define LOG_BUCKET_QUEUE_H
+
+#include "threaded_priority_queue.h"
+#include "bitset_tree.h"
+
+#include <type_traits>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Approximate engine for order-tolerant traffic. Priorities are mapped to logarithmically
+// spaced buckets (the binary exponent plus the top MantissaBits bits of the mantissa) and a
+// HierarchicalBitset tracks the non-empty buckets, so push and pop are O(1) independent of
+// the number of elements. Elements within a bucket come out in LIFO order, which means a pop
+// may return an element up to max_relative_error worse than the true best one.
+//
+// Priorities are arithmetic T, or T::key for KeyedItem-style elements. Magnitudes below
+// 2^MinExp share the zero bucket and magnitudes above 2^MaxExp share the outermost
+// buckets. Only std::less (min first) and std::greater (max first) are supported.
+//
+//     ThreadedPriorityQueue<double, std::less<double>, LogBucketHeap<double>> queue;
+template <typename T, typename Comp = std::less<T>, unsigned MantissaBits = 5, int MinExp = -32, int MaxExp = 64>
+class LogBucketHeap {
+    static_assert(std::is_same_v<Comp, std::less<T>> || std::is_same_v<Comp, std::greater<T>>,
+        "LogBucketHeap supports std::less and std::greater orderings only.");
+    static_assert(MantissaBits <= 16 && MinExp < MaxExp, "LogBucketHeap precision is out of range.");
+
+    static constexpr bool min_first = std::is_same_v<Comp, std::less<T>>;
+    static constexpr size_t per_exponent = size_t(1) << MantissaBits;
+    static constexpr size_t magnitudes = size_t(MaxExp - MinExp) * per_exponent + 1; // Including zero
+    static constexpr size_t bucket_count = 2 * magnitudes - 1; // Negative, zero and positive
+
+    std::vector<std::vector<T>> m_buckets;
+    HierarchicalBitset m_nonEmpty;
+    size_t m_best = 0;
+    size_t m_size = 0;
+    size_t m_maxRankError = 0;
+
+    static inline double priority_of(const T& item) noexcept {
+        if constexpr (std::is_arithmetic_v<T>)
+            return double(item);
+        else
+            return double(item.key);
+    }
+
+    // Monotone map from priority to bucket, negative values below the zero bucket
+    static inline size_t bucket_of(double v) noexcept {
+        const double magnitude = std::fabs(v);
+        size_t m = 0;
+
+        if (magnitude >= std::ldexp(1.0, MinExp)) {
+            int exponent;
+            const double mantissa = std::frexp(magnitude, &exponent); // magnitude = mantissa * 2^exponent, mantissa in [0.5, 1)
+
+            if (exponent > MaxExp)
+                m = magnitudes - 1;
+            else
+                m = 1 + size_t(exponent - MinExp - 1) * per_exponent
+                      + std::min(per_exponent - 1, size_t((mantissa - 0.5) * double(2 * per_exponent)));
+        }
+
+        return std::signbit(v) ? magnitudes - 1 - m : magnitudes - 1 + m;
+    }
+
+    // True when bucket a is popped before bucket b
+    static inline bool bucket_before(size_t a, size_t b) noexcept {
+        return min_first ? a < b : a > b;
+    }
+public:
+    // Upper bound on the relative priority difference between an element and the one
+    // that would have been popped by an exact queue
+    static constexpr double max_relative_error = 1.0 / double(per_exponent);
+
+    LogBucketHeap() : m_buckets(bucket_count), m_nonEmpty(bucket_count) {}
+
+    inline bool empty() const noexcept { return !m_size; }
+    inline size_t size() const noexcept { return m_size; }
+    inline const T& top() const noexcept { return m_buckets[m_best].back(); }
+
+    // Largest number of better-or-equal elements ever passed over by a pop
+    inline size_t max_rank_error() const noexcept { return m_maxRankError; }
+
+    // Capacity hints are spread over the buckets unpredictably, so they are ignored
+    inline void reserve(size_t) noexcept {}
+
+    inline void push(const T& item) {
+        push(T(item));
+    }
+
+    inline void push(T&& item) {
+        const size_t bucket = bucket_of(priority_of(item));
+
+        if (m_buckets[bucket].empty())
+            m_nonEmpty.set(bucket);
+
+        m_buckets[bucket].push_back(std::move(item));
+        if (!m_size++ || bucket_before(bucket, m_best))
+            m_best = bucket;
+    }
+
+    template <typename... Args>
+    inline void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    inline T pop() {
+        std::vector<T>& bucket = m_buckets[m_best];
+        m_maxRankError = std::max(m_maxRankError, bucket.size() - 1);
+
+        T temp = std::move(bucket.back());
+        bucket.pop_back();
+        --m_size;
+
+        if (bucket.empty()) {
+            m_nonEmpty.reset(m_best);
+            if (m_size)
+                m_best = min_first ? m_nonEmpty.first() : m_nonEmpty.last();
+        }
+
+        return temp;
+    }
+
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t) {
+        for (; first != last; ++first)
+            push(T(*first));
+    }
+
+    // Exact order: buckets are walked in order and each one is sorted
+    inline std::vector<T> drain_sorted(size_t) {
+        std::vector<T> out;
+        out.reserve(m_size);
+
+        while (m_size) {
+            std::vector<T>& bucket = m_buckets[m_best];
+            const size_t begin = out.size();
+
+            std::move(bucket.begin(), bucket.end(), std::back_inserter(out));
+            std::sort(out.begin() + begin, out.end(), Comp{});
+
+            m_size -= bucket.size();
+            bucket.clear();
+            m_nonEmpty.reset(m_best);
+
+            if (m_size)
+                m_best = min_first ? m_nonEmpty.first() : m_nonEmpty.last();
+        }
+
+        return out;
+    }
+};
+
+#endif // LOG_BUCKET_QUEUE_H
@@ -0,0 +1,185 @@
+#ifndef LOSER_TREE_H
+#define LOSER_TREE_H
+
+#include <functional>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <utility>
+#include <thread>
+#include <vector>
+
+// Tournament (loser) tree merging a fixed number of sorted input ranges. Each internal node
+// remembers the loser of its match, so producing the next element replays only the path
+// from the winner's leaf to the root: one comparison per level, against log2(k) per push
+// and pop when feeding the runs through a priority queue.
+//
+// The merge is stable: equal elements come out in run order.
+template <typename It, typename Comp = std::less<typename std::iterator_traits<It>::value_type>>
+class LoserTree {
+public:
+    using value_type = typename std::iterator_traits<It>::value_type;
+    using Run = std::pair<It, It>;
+private:
+    std::vector<Run> m_runs;
+    std::vector<size_t> m_tree; // m_tree[0] is the winner, m_tree[1..k) the losers
+    size_t m_k = 0;
+
+    inline bool exhausted(size_t run) const {
+        return m_runs[run].first == m_runs[run].second;
+    }
+
+    // True when run a must be output before run b. One comparison: ties go to the lower
+    // run, so only the higher run has to compare strictly before the other.
+    inline bool beats(size_t a, size_t b) const {
+        if (exhausted(a))
+            return false;
+        if (exhausted(b))
+            return true;
+
+        return a < b ? !Comp{}(*m_runs[b].first, *m_runs[a].first) : Comp{}(*m_runs[a].first, *m_runs[b].first);
+    }
+
+    inline size_t build(size_t node) {
+        if (node >= m_k)
+            return node - m_k;
+
+        const size_t left = build(2 * node);
+        const size_t right = build(2 * node + 1);
+
+        if (beats(left, right)) {
+            m_tree[node] = right;
+            return left;
+        }
+
+        m_tree[node] = left;
+        return right;
+    }
+
+    inline void replay(size_t run) {
+        size_t winner = run;
+
+        for (size_t node = (m_k + run) / 2; node > 0; node /= 2)
+            if (beats(m_tree[node], winner))
+                std::swap(m_tree[node], winner);
+
+        m_tree[0] = winner;
+    }
+public:
+    explicit LoserTree(std::vector<Run> runs) : m_runs(std::move(runs)), m_k(m_runs.size()) {
+        if (!m_k)
+            return;
+
+        m_tree.assign(m_k, 0);
+        m_tree[0] = (m_k == 1) ? 0 : build(1);
+    }
+
+    inline bool empty() const {
+        return !m_k || exhausted(m_tree[0]);
+    }
+
+    // Current position of every run, advanced past the elements already output
+    inline const std::vector<Run>& runs() const noexcept {
+        return m_runs;
+    }
+
+    inline const value_type& top() const {
+        return *m_runs[m_tree[0]].first;
+    }
+
+    inline value_type pop() {
+        const size_t run = m_tree[0];
+        value_type temp = *m_runs[run].first;
+
+        ++m_runs[run].first;
+        replay(run);
+
+        return temp;
+    }
+
+    // Writes up to max_count merged elements to out
+    template <typename OutIt>
+    inline OutIt merge(OutIt out, size_t max_count = SIZE_MAX) {
+        for (; max_count && !empty(); --max_count) {
+            const size_t run = m_tree[0];
+
+            *out = *m_runs[run].first;
+            ++out;
+
+            ++m_runs[run].first;
+            replay(run);
+        }
+
+        return out;
+    }
+
+    // Merges all runs into out using up to `threads` threads. The key space is split at
+    // splitters sampled from the runs, each slice is located in every run by binary search
+    // and merged independently into its final position. Requires random access iterators
+    // for both the runs and the output.
+    template <typename OutIt>
+    static inline OutIt parallel_merge(const std::vector<Run>& runs, OutIt out, size_t threads = std::thread::hardware_concurrency()) {
+        size_t total = 0;
+        for (const Run& run : runs)
+            total += size_t(run.second - run.first);
+
+        constexpr size_t min_slice = 1 << 14;
+        threads = std::max<size_t>(1, std::min(threads, total / min_slice));
+
+        if (threads == 1) {
+            LoserTree tree(runs);
+            return tree.merge(out);
+        }
+
+        // Sample every run evenly and pick threads - 1 splitters from the sorted sample
+        constexpr size_t oversample = 16;
+        std::vector<value_type> sample;
+        for (const Run& run : runs) {
+            const size_t n = size_t(run.second - run.first);
+            const size_t step = std::max<size_t>(1, n / (oversample * threads / runs.size() + 1));
+            for (size_t i = step / 2; i < n; i += step)
+                sample.push_back(run.first[i]);
+        }
+        std::sort(sample.begin(), sample.end(), Comp{});
+
+        // bounds[p][r] is where slice p starts in run r
+        std::vector<std::vector<It>> bounds(threads + 1, std::vector<It>(runs.size()));
+        for (size_t r = 0; r < runs.size(); ++r) {
+            bounds[0][r] = runs[r].first;
+            bounds[threads][r] = runs[r].second;
+        }
+
+        for (size_t p = 1; p < threads; ++p) {
+            const value_type& splitter = sample[p * sample.size() / threads];
+            for (size_t r = 0; r < runs.size(); ++r)
+                bounds[p][r] = std::lower_bound(bounds[p - 1][r], runs[r].second, splitter, Comp{});
+        }
+
+        std::vector<std::thread> workers;
+        size_t offset = 0;
+
+        for (size_t p = 0; p < threads; ++p) {
+            std::vector<Run> slice(runs.size());
+            size_t count = 0;
+
+            for (size_t r = 0; r < runs.size(); ++r) {
+                slice[r] = Run(bounds[p][r], bounds[p + 1][r]);
+                count += size_t(slice[r].second - slice[r].first);
+            }
+
+            workers.emplace_back([slice = std::move(slice), dest = out + offset]() mutable {
+                LoserTree tree(std::move(slice));
+                tree.merge(dest);
+            });
+
+            offset += count;
+        }
+
+        for (std::thread& worker : workers)
+            worker.join();
+
+        return out + total;
+    }
+};
+
+#endif // LOSER_TREE_H
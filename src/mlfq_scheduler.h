@@ -0,0 +1,212 @@
+#ifndef MLFQ_SCHEDULER_H
+#define MLFQ_SCHEDULER_H
+
+#include <condition_variable>
+#include <stdexcept>
+#include <optional>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <list>
+
+// Multi-level feedback queue for CPU-bound jobs. Jobs enter at level 0 (highest priority),
+// drop one level once they have used up that level's time allotment, and are moved back to
+// level 0 every boost interval.
+//
+// Each level is a FIFO list and a bitmask tracks the non-empty levels, so picking the next
+// job, demoting and requeueing are O(1). A boost splices every level into level 0 in
+// O(levels); the per-job allotments are reset lazily through a boost epoch. Tickets carry
+// their list node, so a job cycling through wait_next()/requeue() never reallocates.
+//
+// Blocking follows ThreadedPriorityQueue: wait_next() sleeps until a job is available and
+// returns std::nullopt once done() has been called and no jobs remain.
+template <typename Job>
+class MLFQScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = Clock::duration;
+private:
+    struct Entry {
+        Job job;
+        Duration used{};     // Time consumed at the current level
+        uint64_t epoch = 0;  // Boost epoch in which `used` was accumulated
+    };
+
+    std::vector<std::list<Entry>> m_levels;
+    std::vector<Duration> m_quanta;
+    uint64_t m_nonEmpty = 0; // Bit i set when level i holds jobs
+    uint64_t m_epoch = 0;
+    size_t m_size = 0;
+
+    Duration m_boostInterval;
+    Clock::time_point m_lastBoost = Clock::now();
+
+    std::condition_variable m_readCondition;
+    mutable std::mutex m_commMutex;
+    bool m_isDone = false;
+
+    static inline size_t lowest_set(uint64_t bits) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+        return size_t(__builtin_ctzll(bits));
+#else
+        size_t i = 0;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    inline void enqueue(std::list<Entry>& node, size_t level) noexcept {
+        m_levels[level].splice(m_levels[level].end(), node);
+        m_nonEmpty |= uint64_t(1) << level;
+        ++m_size;
+    }
+
+    inline void maybe_boost() noexcept {
+        const Clock::time_point now = Clock::now();
+        if (now - m_lastBoost < m_boostInterval)
+            return;
+
+        m_lastBoost = now;
+        ++m_epoch; // Invalidates every job's accumulated allotment
+
+        for (size_t level = 1; level < m_levels.size(); ++level)
+            m_levels[0].splice(m_levels[0].end(), m_levels[level]);
+
+        m_nonEmpty = m_levels[0].empty() ? 0 : 1;
+    }
+public:
+    // A job handed out by wait_next(). Return it with requeue() if it still has work left.
+    class Ticket {
+        friend class MLFQScheduler;
+        std::list<Entry> m_node;
+        size_t m_level = 0;
+        Duration m_remaining{};
+    public:
+        inline Job& job() noexcept { return m_node.front().job; }
+        inline const Job& job() const noexcept { return m_node.front().job; }
+        inline size_t level() const noexcept { return m_level; }
+
+        // Run time left before the job is demoted
+        inline Duration quantum() const noexcept { return m_remaining; }
+    };
+
+    // quanta[i] is the time allotment of level i; the last level never demotes further
+    MLFQScheduler(std::vector<Duration> quanta, Duration boost_interval)
+        : m_levels(quanta.size()), m_quanta(std::move(quanta)), m_boostInterval(boost_interval) {
+        if (m_quanta.empty() || m_quanta.size() > 64)
+            throw std::invalid_argument("MLFQScheduler requires between 1 and 64 levels.");
+    }
+
+    MLFQScheduler(const MLFQScheduler&) = delete;
+    MLFQScheduler& operator=(const MLFQScheduler&) = delete;
+
+    // New jobs start at the highest priority level
+    inline void submit(Job job) {
+        std::list<Entry> node;
+        node.push_back(Entry{std::move(job), Duration{}, 0});
+
+        std::lock_guard<std::mutex> lock(m_commMutex);
+        node.front().epoch = m_epoch;
+        enqueue(node, 0);
+        m_readCondition.notify_one();
+    }
+
+    // Puts a job back after it ran for `used`. It is demoted once its allotment is spent.
+    inline void requeue(Ticket&& ticket, Duration used) {
+        std::lock_guard<std::mutex> lock(m_commMutex);
+        Entry& entry = ticket.m_node.front();
+        size_t level = ticket.m_level;
+
+        if (entry.epoch != m_epoch) { // Boosted while running
+            entry.epoch = m_epoch;
+            entry.used = Duration{};
+            level = 0;
+        }
+
+        entry.used += used;
+        if (entry.used >= m_quanta[level]) {
+            entry.used = Duration{};
+            if (level + 1 < m_levels.size())
+                ++level;
+        }
+
+        enqueue(ticket.m_node, level);
+        m_readCondition.notify_one();
+    }
+
+    inline std::optional<Ticket> try_next() {
+        std::lock_guard<std::mutex> lock(m_commMutex);
+        return take();
+    }
+
+    inline std::optional<Ticket> wait_next() { // Waits til non-empty
+        std::unique_lock<std::mutex> lock(m_commMutex);
+
+        // Wait until non-empty or done
+        m_readCondition.wait(lock, [this] {
+            return m_size || m_isDone;
+        });
+
+        return take();
+    }
+
+    inline size_t size() const noexcept {
+        return m_size;
+    }
+
+    inline bool empty() const noexcept {
+        return !m_size;
+    }
+
+    inline size_t levels() const noexcept {
+        return m_levels.size();
+    }
+
+    // Done function
+    inline void done() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_isDone = true;
+        }
+
+        // Notify after unlock
+        m_readCondition.notify_all();
+    }
+
+    inline bool is_done() const noexcept {
+        return m_isDone;
+    }
+private:
+    inline std::optional<Ticket> take() {
+        if (!m_size)
+            return std::nullopt;
+
+        maybe_boost();
+
+        const size_t level = lowest_set(m_nonEmpty);
+        std::list<Entry>& queue = m_levels[level];
+
+        Ticket ticket;
+        ticket.m_node.splice(ticket.m_node.end(), queue, queue.begin());
+        ticket.m_level = level;
+
+        if (queue.empty())
+            m_nonEmpty &= ~(uint64_t(1) << level);
+        --m_size;
+
+        Entry& entry = ticket.m_node.front();
+        if (entry.epoch != m_epoch) {
+            entry.epoch = m_epoch;
+            entry.used = Duration{};
+        }
+        ticket.m_remaining = m_quanta[level] - entry.used;
+
+        return std::make_optional<Ticket>(std::move(ticket));
+    }
+};
+
+#endif // MLFQ_SCHEDULER_H
@@ -0,0 +1,368 @@
+#ifndef NUMA_QUEUE_H
+#define NUMA_QUEUE_H
+
+#include "threaded_priority_queue.h"
+
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+#include <optional>
+#include <fstream>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sched.h>
+#endif
+
+// CPU to NUMA node map read from /sys/devices/system/node. Machines without NUMA (or
+// without sysfs) report a single node 0.
+class NumaTopology {
+    std::vector<int> m_nodeOfCpu;
+    size_t m_nodes = 1;
+
+    // Parses a cpulist such as "0-3,8-11"
+    static inline std::vector<int> parse_cpulist(const std::string& list) {
+        std::vector<int> cpus;
+        size_t pos = 0;
+
+        while (pos < list.size()) {
+            const size_t comma = std::min(list.find(',', pos), list.size());
+            const std::string range = list.substr(pos, comma - pos);
+            const size_t dash = range.find('-');
+
+            if (!range.empty()) {
+                const int first = std::stoi(range.substr(0, dash));
+                const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(cpu);
+            }
+
+            pos = comma + 1;
+        }
+
+        return cpus;
+    }
+public:
+    NumaTopology() {
+#if defined(__linux__)
+        size_t nodes = 0;
+        for (int node = 0;; ++node) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file)
+                break;
+
+            std::string list;
+            std::getline(file, list);
+
+            for (int cpu : parse_cpulist(list)) {
+                if (size_t(cpu) >= m_nodeOfCpu.size())
+                    m_nodeOfCpu.resize(size_t(cpu) + 1, 0);
+                m_nodeOfCpu[size_t(cpu)] = node;
+            }
+            ++nodes;
+        }
+
+        m_nodes = std::max<size_t>(nodes, 1);
+#endif
+    }
+
+    inline size_t nodes() const noexcept { return m_nodes; }
+
+    inline int node_of_cpu(int cpu) const noexcept {
+        return cpu >= 0 && size_t(cpu) < m_nodeOfCpu.size() ? m_nodeOfCpu[size_t(cpu)] : 0;
+    }
+
+    // Node of the CPU the calling thread runs on right now
+    inline int current_node() const noexcept {
+#if defined(__linux__)
+        return node_of_cpu(sched_getcpu());
+#else
+        return 0;
+#endif
+    }
+};
+
+// Storage policy placing the heap array on one NUMA node. Memory is mapped anonymously and
+// bound with mbind(MPOL_PREFERRED) before it is touched, so pages fault in on that node.
+// Without NUMA support the mapping simply uses the default policy.
+class NumaLocalStorage {
+    int m_node = -1; // -1 leaves placement to the kernel
+
+#if defined(__linux__)
+    static inline size_t page_size() noexcept {
+        static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+        return page;
+    }
+
+    static inline size_t round_to_pages(size_t bytes) noexcept {
+        const size_t page = page_size();
+        return (bytes + page - 1) / page * page;
+    }
+#endif
+public:
+    NumaLocalStorage() = default;
+    explicit NumaLocalStorage(int node) : m_node(node) {}
+
+    inline int node() const noexcept { return m_node; }
+
+#if defined(__linux__)
+    // Growth fills whole pages, see storage_runtime_granularity
+    inline size_t granularity() const noexcept { return page_size(); }
+
+    inline void* allocate(size_t bytes, size_t alignment) {
+        if (alignment > page_size())
+            throw std::bad_alloc(); // Mappings are only page aligned
+
+        const size_t length = round_to_pages(bytes);
+        void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+
+        if (m_node >= 0) {
+            constexpr int mpol_preferred = 1;
+            constexpr size_t bits = 8 * sizeof(unsigned long);
+
+            std::vector<unsigned long> mask(size_t(m_node) / bits + 1, 0);
+            mask[size_t(m_node) / bits] |= 1ul << (size_t(m_node) % bits);
+
+            // Best effort, the mapping stays usable if the kernel refuses the policy. The
+            // kernel reads maxnode - 1 bits of the mask, hence the + 1.
+            syscall(SYS_mbind, ptr, length, mpol_preferred, mask.data(), mask.size() * bits + 1, 0u);
+        }
+
+        return ptr;
+    }
+
+    inline void deallocate(void* ptr, size_t bytes, size_t) noexcept {
+        munmap(ptr, round_to_pages(bytes));
+    }
+#else
+    inline void* allocate(size_t bytes, size_t alignment) {
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    inline void deallocate(void* ptr, size_t, size_t alignment) noexcept {
+        ::operator delete(ptr, std::align_val_t(alignment));
+    }
+#endif
+};
+
+// Priority queue with one sub-queue per NUMA node, each stored in node-local memory under
+// its own mutex. Threads push to and pop from the sub-queue of the node they run on. A pop
+// falls back to the other nodes when the local sub-queue is empty, and every
+// remote_check_interval-th pop of a thread compares all node tops and takes the best, so
+// a local sub-queue whose top is much worse than a remote one cannot starve the better
+// elements for long.
+//
+// Ordering is exact within a node and approximate across nodes. The blocking calls mirror
+// ThreadedPriorityQueue.
+template <typename T, typename Comp = std::less<T>>
+class NumaPriorityQueue {
+    struct alignas(64) Node {
+        std::mutex mutex;
+        BinaryHeap<T, Comp, NumaLocalStorage> heap;
+
+        explicit Node(int node) : heap(NumaLocalStorage(node)) {}
+    };
+
+    NumaTopology m_topology;
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    size_t m_remoteInterval;
+
+    std::condition_variable m_readCondition;
+    std::mutex m_commMutex;
+    std::atomic<size_t> m_size{0};
+    std::atomic<size_t> m_waiters{0};
+    std::atomic<bool> m_isDone{false};
+
+    inline size_t local_node() const noexcept {
+        return size_t(m_topology.current_node()) % m_nodes.size();
+    }
+
+    inline void notify_waiters() {
+        if (m_waiters.load()) {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_readCondition.notify_all();
+        }
+    }
+
+    template <typename... Args>
+    inline void push_local(Args&&... args) {
+        Node& node = *m_nodes[local_node()];
+
+        {
+            std::lock_guard<std::mutex> lock(node.mutex);
+            node.heap.emplace(std::forward<Args>(args)...);
+            m_size.fetch_add(1);
+        }
+
+        notify_waiters();
+    }
+
+    // Pops the top of node, the caller holds its mutex and checked it is non-empty
+    inline T pop_locked(Node& node) {
+        T temp = node.heap.pop();
+
+        // Wake wait_empty_push callers once the queue drains
+        if (m_size.fetch_sub(1) == 1)
+            notify_waiters();
+
+        return temp;
+    }
+
+    // Index of the node with the best top, or m_nodes.size() when all are empty. The
+    // current best node stays locked while the next one is compared against it, so tops
+    // are compared in place instead of copied. Locks are taken in index order.
+    inline size_t best_node() {
+        size_t best_index = m_nodes.size();
+        std::unique_lock<std::mutex> best_lock;
+
+        for (size_t i = 0; i < m_nodes.size(); ++i) {
+            std::unique_lock<std::mutex> lock(m_nodes[i]->mutex);
+            const BinaryHeap<T, Comp, NumaLocalStorage>& heap = m_nodes[i]->heap;
+
+            if (!heap.empty() && (best_index == m_nodes.size() || Comp{}(heap.top(), m_nodes[best_index]->heap.top()))) {
+                best_index = i;
+                best_lock = std::move(lock);
+            }
+        }
+
+        return best_index;
+    }
+public:
+    explicit NumaPriorityQueue(size_t remote_check_interval = 16) : m_remoteInterval(std::max<size_t>(remote_check_interval, 1)) {
+        for (size_t i = 0; i < m_topology.nodes(); ++i)
+            m_nodes.push_back(std::make_unique<Node>(m_topology.nodes() > 1 ? int(i) : -1));
+    }
+
+    NumaPriorityQueue(const NumaPriorityQueue&) = delete;
+    NumaPriorityQueue& operator=(const NumaPriorityQueue&) = delete;
+
+    // Push and pop
+    inline void push(const T& item) {
+        push_local(item);
+    }
+
+    inline void push(T&& item) {
+        push_local(std::move(item));
+    }
+
+    template <typename... Args>
+    inline void push(Args&&... args) {
+        push_local(std::forward<Args>(args)...);
+    }
+
+    // Local first, nullopt when every node is empty
+    inline std::optional<T> try_pop() {
+        static thread_local size_t pops = 0;
+        const size_t local = local_node();
+
+        if (++pops % m_remoteInterval) {
+            Node& node = *m_nodes[local];
+            std::lock_guard<std::mutex> lock(node.mutex);
+
+            if (!node.heap.empty())
+                return pop_locked(node);
+        }
+
+        // Local node empty or due for a remote check. The best node may be emptied by
+        // another consumer before it is locked again, so retry while anything is left.
+        while (m_size.load()) {
+            const size_t index = best_node();
+            if (index == m_nodes.size())
+                break;
+
+            Node& node = *m_nodes[index];
+            std::lock_guard<std::mutex> lock(node.mutex);
+
+            if (!node.heap.empty())
+                return pop_locked(node);
+        }
+
+        return std::nullopt;
+    }
+
+    inline T pop() {
+        std::optional<T> temp = try_pop();
+        if (!temp)
+            throw std::runtime_error("pop() attempted on empty priority queue.");
+
+        return std::move(*temp);
+    }
+
+    // Threaded push/pop
+    inline void wait_empty_push(T item) { // Waits til empty
+        {
+            std::unique_lock<std::mutex> lock(m_commMutex);
+            m_waiters.fetch_add(1);
+
+            // Wait until empty or done
+            m_readCondition.wait(lock, [this] {
+                return !m_size.load() || m_isDone.load();
+            });
+
+            m_waiters.fetch_sub(1);
+            if (m_isDone.load())
+                return;
+        }
+
+        push_local(std::move(item));
+    }
+
+    inline std::optional<T> wait_nonempty_pop() { // Waits til non-empty
+        while (true) {
+            if (std::optional<T> temp = try_pop())
+                return temp;
+
+            std::unique_lock<std::mutex> lock(m_commMutex);
+            m_waiters.fetch_add(1);
+
+            // Wait until non-empty or done
+            m_readCondition.wait(lock, [this] {
+                return m_size.load() || m_isDone.load();
+            });
+
+            m_waiters.fetch_sub(1);
+            if (!m_size.load() && m_isDone.load())
+                return std::nullopt;
+        }
+    }
+
+    // Strict getters
+    inline size_t size() const noexcept {
+        return m_size.load();
+    }
+
+    inline bool empty() const noexcept {
+        return !m_size.load();
+    }
+
+    inline size_t nodes() const noexcept {
+        return m_nodes.size();
+    }
+
+    // Done function
+    inline void done() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_isDone.store(true);
+        }
+
+        // Notify after unlock
+        m_readCondition.notify_all();
+    }
+
+    inline bool is_done() const noexcept {
+        return m_isDone.load();
+    }
+};
+
+#endif // NUMA_QUEUE_H
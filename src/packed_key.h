@@ -0,0 +1,147 @@
+#ifndef PACKED_KEY_H
+#define PACKED_KEY_H
+
+#include <type_traits>
+#include <cstdint>
+#include <climits>
+#include <stdexcept>
+#include <cstring>
+#include <utility>
+
+// Packs multi-field priorities (e.g. tier, deadline, sequence) into a single unsigned
+// 64-bit or 128-bit word whose plain integer order equals the lexicographic order of
+// the fields. Comparing two packed keys is then a single integer compare instead of a
+// chain of branches in Comp.
+//
+// Fields are appended most significant first. Each field is mapped to an order
+// preserving unsigned encoding:
+//  - unsigned integers are stored as-is
+//  - signed integers have their sign bit flipped (two's complement bias)
+//  - floating point values have the sign bit flipped when positive and all bits
+//    inverted when negative, so more negative values encode smaller. -0.0 encodes just
+//    below +0.0, and NaNs sort beyond the infinity of their sign.
+// A field may be narrowed to fewer bits than its type. Narrowed integers must fit the
+// requested width; narrowed floats keep their most significant bits, which preserves
+// order but may turn nearby values into ties. add() throws std::length_error for a width
+// that does not fit the word and std::out_of_range for an integer that does not fit its
+// width, as masking either would silently reorder keys.
+
+#if defined(__SIZEOF_INT128__)
+#define PACKED_KEY_HAS_128 1
+using PackedKey128 = unsigned __int128;
+#endif
+
+template <typename Word>
+struct is_packed_key_word : std::bool_constant<std::is_integral_v<Word> && std::is_unsigned_v<Word>> {};
+
+#ifdef PACKED_KEY_HAS_128
+template <>
+struct is_packed_key_word<PackedKey128> : std::true_type {};
+#endif
+
+template <typename Word = uint64_t>
+class PackedKey {
+    static_assert(is_packed_key_word<Word>::value, "PackedKey requires an unsigned integer word.");
+
+    Word m_bits = 0;
+    unsigned m_used = 0;
+
+    template <typename F>
+    using UnsignedOf = std::conditional_t<sizeof(F) == 1, uint8_t,
+                       std::conditional_t<sizeof(F) == 2, uint16_t,
+                       std::conditional_t<sizeof(F) == 4, uint32_t, uint64_t>>>;
+
+    static constexpr Word mask(unsigned bits) noexcept {
+        return bits >= word_bits ? ~Word(0) : (Word(1) << bits) - 1;
+    }
+public:
+    static constexpr unsigned word_bits = sizeof(Word) * CHAR_BIT;
+
+    PackedKey() = default;
+
+    // Order preserving encoding of a single field at its full width
+    template <typename F>
+    static inline UnsignedOf<F> encode(F value) noexcept {
+        static_assert(std::is_arithmetic_v<F> && sizeof(F) <= 8, "PackedKey fields must be arithmetic and at most 64 bits.");
+        using U = UnsignedOf<F>;
+        constexpr U sign_bit = U(1) << (sizeof(F) * CHAR_BIT - 1);
+
+        if constexpr (std::is_floating_point_v<F>) {
+            static_assert(sizeof(F) == sizeof(U), "Unsupported floating point width.");
+            U bits;
+            memcpy(&bits, &value, sizeof(F));
+            return (bits & sign_bit) ? U(~bits) : U(bits | sign_bit);
+        } else if constexpr (std::is_signed_v<F>)
+            return U(U(value) ^ sign_bit);
+        else
+            return U(value);
+    }
+
+    // Appends a field below the ones already packed. Descending fields invert their encoding.
+    template <typename F>
+    inline PackedKey& add(F value, unsigned bits = sizeof(F) * CHAR_BIT, bool descending = false) {
+        constexpr unsigned full = sizeof(F) * CHAR_BIT;
+        if (bits == 0 || bits > full || bits > word_bits - m_used)
+            throw std::length_error("PackedKey field width does not fit.");
+
+        Word field;
+        if constexpr (std::is_floating_point_v<F>)
+            field = Word(encode(value) >> (full - bits));
+        else if constexpr (std::is_signed_v<F>) {
+            // Bias within the narrowed width so that the field's sign bit is the one flipped
+            if (bits < full && (value < -(int64_t(1) << (bits - 1)) || value >= (int64_t(1) << (bits - 1))))
+                throw std::out_of_range("PackedKey field value outside its width.");
+            field = (Word(UnsignedOf<F>(value)) + (Word(1) << (bits - 1))) & mask(bits);
+        } else {
+            if (bits < full && uint64_t(value) > uint64_t(mask(bits)))
+                throw std::out_of_range("PackedKey field value outside its width.");
+            field = Word(value) & mask(bits);
+        }
+
+        if (descending)
+            field = ~field & mask(bits);
+
+        m_bits = (bits >= word_bits) ? field : Word((m_bits << bits) | field);
+        m_used += bits;
+        return *this;
+    }
+
+    template <typename F>
+    inline PackedKey& add_descending(F value, unsigned bits = sizeof(F) * CHAR_BIT) {
+        return add(value, bits, true);
+    }
+
+    inline Word value() const noexcept { return m_bits; }
+    inline unsigned used_bits() const noexcept { return m_used; }
+
+    // Packs every field at its full width, most significant first
+    template <typename... Fields>
+    static inline Word pack(Fields... fields) noexcept {
+        static_assert((0 + ... + (sizeof(Fields) * CHAR_BIT)) <= word_bits, "Fields do not fit in the packed key word.");
+
+        PackedKey key;
+        (key.add(fields), ...);
+        return key.value();
+    }
+};
+
+// Queue element carrying a precomputed key next to its payload. Ordering only looks at the
+// key, so a ThreadedPriorityQueue<KeyedItem<uint64_t, Job>> compares one integer per step.
+template <typename Key, typename Payload>
+struct KeyedItem {
+    using key_type = Key;
+    using payload_type = Payload;
+
+    Key key{};
+    Payload payload{};
+
+    KeyedItem() = default;
+
+    template <typename P>
+    KeyedItem(const Key& k, P&& p) : key(k), payload(std::forward<P>(p)) {}
+
+    inline bool operator<(const KeyedItem& other) const noexcept { return key < other.key; }
+    inline bool operator>(const KeyedItem& other) const noexcept { return other.key < key; }
+};
+
+#endif // PACKED_KEY_H
@@ -0,0 +1,211 @@
+#ifndef PERSISTENT_HEAP_H
+#define PERSISTENT_HEAP_H
+
+#include "threaded_priority_queue.h"
+#include "epoch_reclamation.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+// Engine backed by a persistent leftist heap. Nodes are immutable: a push or pop copies
+// the O(log n) nodes on the merge path, shares the rest with the previous version and
+// publishes the new root atomically. Readers call snapshot() to get an immutable version
+// without taking m_commMutex, so monitoring threads never block producers or consumers.
+// Replaced nodes are reclaimed through an EpochDomain once no snapshot can reach them.
+//
+//     ThreadedPriorityQueue<Job, ByPriority, PersistentHeap<Job, ByPriority>> queue;
+//     auto view = queue.engine().snapshot(); // Lock-free, consistent
+//     view.for_each([](const Job& job) { ... });
+template <typename T, typename Comp = std::less<T>>
+class PersistentHeap {
+    struct Node {
+        T value;
+        const Node* left;
+        const Node* right;
+        uint32_t rank; // Length of the right spine
+        size_t size;
+    };
+
+    std::atomic<const Node*> m_root{nullptr};
+    std::vector<const Node*> m_replaced; // Nodes superseded by the mutation in progress
+    mutable EpochDomain m_epochs;
+
+    static inline uint32_t rank_of(const Node* node) noexcept {
+        return node ? node->rank : 0;
+    }
+
+    static inline size_t size_of(const Node* node) noexcept {
+        return node ? node->size : 0;
+    }
+
+    // Persistent merge: copies the nodes along the right spines it walks
+    inline const Node* merge(const Node* a, const Node* b) {
+        if (!a)
+            return b;
+        if (!b)
+            return a;
+        if (Comp{}(b->value, a->value))
+            std::swap(a, b);
+
+        const Node* left = a->left;
+        const Node* right = merge(a->right, b);
+        if (rank_of(left) < rank_of(right))
+            std::swap(left, right);
+
+        const Node* node = new Node{a->value, left, right, rank_of(right) + 1, a->size + b->size};
+        m_replaced.push_back(a);
+        return node;
+    }
+
+    inline void publish(const Node* root) {
+        m_root.store(root);
+
+        for (const Node* node : m_replaced)
+            m_epochs.retire(node);
+        m_replaced.clear();
+    }
+
+    static inline void destroy(const Node* node) noexcept {
+        std::vector<const Node*> stack;
+        if (node)
+            stack.push_back(node);
+
+        while (!stack.empty()) {
+            const Node* current = stack.back();
+            stack.pop_back();
+
+            if (current->left)
+                stack.push_back(current->left);
+            if (current->right)
+                stack.push_back(current->right);
+            delete current;
+        }
+    }
+public:
+    // Immutable view of one version of the heap, valid for the snapshot's lifetime
+    class Snapshot {
+        friend class PersistentHeap;
+        EpochDomain::Guard m_guard;
+        const Node* m_root = nullptr;
+
+        Snapshot(EpochDomain::Guard guard, const Node* root) : m_guard(std::move(guard)), m_root(root) {}
+    public:
+        Snapshot() = default;
+
+        inline bool empty() const noexcept { return !m_root; }
+        inline size_t size() const noexcept { return size_of(m_root); }
+        inline const T& top() const noexcept { return m_root->value; }
+
+        // Visits every element in heap order (each before its descendants)
+        template <typename F>
+        inline void for_each(F&& f) const {
+            std::vector<const Node*> stack;
+            if (m_root)
+                stack.push_back(m_root);
+
+            while (!stack.empty()) {
+                const Node* node = stack.back();
+                stack.pop_back();
+
+                f(node->value);
+                if (node->right)
+                    stack.push_back(node->right);
+                if (node->left)
+                    stack.push_back(node->left);
+            }
+        }
+
+        // Copy of the contents in pop order
+        inline std::vector<T> sorted() const {
+            std::vector<T> out;
+            out.reserve(size());
+
+            for_each([&out](const T& value) { out.push_back(value); });
+            std::sort(out.begin(), out.end(), Comp{});
+            return out;
+        }
+    };
+
+    PersistentHeap() = default;
+
+    PersistentHeap(const PersistentHeap&) = delete;
+    PersistentHeap& operator=(const PersistentHeap&) = delete;
+
+    ~PersistentHeap() {
+        destroy(m_root.load());
+    }
+
+    // Lock-free, safe to call concurrently with mutations
+    inline Snapshot snapshot() const {
+        EpochDomain::Guard guard = m_epochs.pin();
+        const Node* root = m_root.load();
+        return Snapshot(std::move(guard), root);
+    }
+
+    inline bool empty() const noexcept { return !m_root.load(std::memory_order_relaxed); }
+    inline size_t size() const noexcept { return size_of(m_root.load(std::memory_order_relaxed)); }
+    inline const T& top() const noexcept { return m_root.load(std::memory_order_relaxed)->value; }
+
+    // Nodes are allocated per mutation
+    inline void reserve(size_t) noexcept {}
+
+    inline void push(const T& item) {
+        const Node* single = new Node{item, nullptr, nullptr, 1, 1};
+        publish(merge(m_root.load(std::memory_order_relaxed), single));
+    }
+
+    inline void push(T&& item) {
+        const Node* single = new Node{std::move(item), nullptr, nullptr, 1, 1};
+        publish(merge(m_root.load(std::memory_order_relaxed), single));
+    }
+
+    template <typename... Args>
+    inline void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    // Copies the value out, older snapshots may still be reading the node
+    inline T pop() {
+        const Node* root = m_root.load(std::memory_order_relaxed);
+        T temp = root->value;
+
+        const Node* next = merge(root->left, root->right);
+        m_replaced.push_back(root);
+        publish(next);
+
+        return temp;
+    }
+
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t) {
+        for (; first != last; ++first)
+            push(T(*first));
+    }
+
+    inline std::vector<T> drain_sorted(size_t) {
+        std::vector<T> out = snapshot().sorted();
+
+        // The whole tree becomes unreachable at once
+        std::vector<const Node*> stack;
+        if (const Node* root = m_root.load(std::memory_order_relaxed))
+            stack.push_back(root);
+
+        while (!stack.empty()) {
+            const Node* node = stack.back();
+            stack.pop_back();
+
+            if (node->left)
+                stack.push_back(node->left);
+            if (node->right)
+                stack.push_back(node->right);
+            m_replaced.push_back(node);
+        }
+
+        publish(nullptr);
+        return out;
+    }
+};
+
+#endif // PERSISTENT_HEAP_H
@@ -0,0 +1,157 @@
+#ifndef RUN_LENGTH_HEAP_H
+#define RUN_LENGTH_HEAP_H
+
+#include "threaded_priority_queue.h"
+
+#include <unordered_map>
+#include <vector>
+#include <deque>
+
+// Engine for workloads where many elements share a handful of priorities. Elements with
+// equal keys are grouped into a single heap node holding a FIFO block, so the heap only
+// sifts over distinct keys and a push to an existing key is an O(1) append found through
+// a key-to-node index.
+//
+// T exposes its priority as T::key_type / T::key, as KeyedItem from packed_key.h does.
+// Elements with equal keys must compare equivalent under Comp.
+//
+//     ThreadedPriorityQueue<Item, std::less<Item>, RunLengthHeap<Item>> queue;
+template <typename T, typename Comp = std::less<T>, typename Hash = std::hash<typename T::key_type>>
+class RunLengthHeap {
+    using Key = typename T::key_type;
+
+    std::vector<std::deque<T>> m_nodes; // Heap of FIFO blocks, ordered by their front element
+    std::unordered_map<Key, size_t, Hash> m_index; // Key -> position in m_nodes
+    std::vector<std::deque<T>> m_spare; // Emptied blocks kept for reuse
+    size_t m_size = 0;
+
+    static constexpr size_t max_spare = 16;
+
+    inline bool less(size_t a, size_t b) const {
+        return Comp{}(m_nodes[a].front(), m_nodes[b].front());
+    }
+
+    inline void swap_nodes(size_t a, size_t b) {
+        m_nodes[a].swap(m_nodes[b]); // Swaps block pointers, never reallocates
+        m_index[m_nodes[a].front().key] = a;
+        m_index[m_nodes[b].front().key] = b;
+    }
+
+    inline void percolate_up(size_t index) {
+        while (index > 0) {
+            const size_t parent_index = (index - 1) / 2;
+            if (!less(index, parent_index))
+                break;
+
+            swap_nodes(index, parent_index);
+            index = parent_index;
+        }
+    }
+
+    inline void percolate_down(size_t index) {
+        const size_t n = m_nodes.size();
+
+        while (2 * index + 1 < n) {
+            const size_t left_child = 2 * index + 1;
+            const size_t right_child = 2 * index + 2;
+
+            size_t largest_index = index;
+            if (less(left_child, largest_index))
+                largest_index = left_child;
+
+            if (right_child < n && less(right_child, largest_index))
+                largest_index = right_child;
+
+            if (largest_index == index)
+                break;
+
+            swap_nodes(index, largest_index);
+            index = largest_index;
+        }
+    }
+public:
+    RunLengthHeap() = default;
+
+    inline bool empty() const noexcept { return !m_size; }
+    inline size_t size() const noexcept { return m_size; }
+    inline const T& top() const noexcept { return m_nodes[0].front(); }
+
+    // Number of distinct priorities currently queued
+    inline size_t distinct_keys() const noexcept { return m_nodes.size(); }
+
+    // Capacity hints are in elements, which says nothing about the number of distinct keys
+    inline void reserve(size_t) noexcept {}
+
+    inline void push(const T& item) { push(T(item)); }
+
+    inline void push(T&& item) {
+        ++m_size;
+
+        auto it = m_index.find(item.key);
+        if (it != m_index.end()) {
+            m_nodes[it->second].push_back(std::move(item));
+            return;
+        }
+
+        if (!m_spare.empty()) {
+            m_nodes.push_back(std::move(m_spare.back()));
+            m_spare.pop_back();
+        } else
+            m_nodes.emplace_back();
+
+        const Key key = item.key;
+        m_nodes.back().push_back(std::move(item));
+        m_index.emplace(key, m_nodes.size() - 1);
+        percolate_up(m_nodes.size() - 1);
+    }
+
+    template <typename... Args>
+    inline void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    inline T pop() {
+        std::deque<T>& block = m_nodes[0];
+        T temp = std::move(block.front());
+        block.pop_front();
+        --m_size;
+
+        if (block.empty()) {
+            // The index entry is keyed by the popped element since the block is now empty
+            m_index.erase(temp.key);
+
+            const size_t last = m_nodes.size() - 1;
+            if (last > 0) {
+                m_nodes[0].swap(m_nodes[last]);
+                m_index[m_nodes[0].front().key] = 0;
+            }
+
+            if (m_spare.size() < max_spare)
+                m_spare.push_back(std::move(m_nodes.back()));
+            m_nodes.pop_back();
+
+            if (!m_nodes.empty())
+                percolate_down(0);
+        }
+
+        return temp;
+    }
+
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t) {
+        for (; first != last; ++first)
+            push(T(*first));
+    }
+
+    inline std::vector<T> drain_sorted(size_t) {
+        std::vector<T> out;
+        out.reserve(m_size);
+
+        while (m_size)
+            out.push_back(pop());
+
+        return out;
+    }
+};
+
+#endif // RUN_LENGTH_HEAP_H
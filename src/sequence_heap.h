@@ -0,0 +1,192 @@
+#ifndef SEQUENCE_HEAP_H
+#define SEQUENCE_HEAP_H
+
+#include "threaded_priority_queue.h"
+#include "loser_tree.h"
+
+#include <type_traits>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+// Sequence heap engine (after Sanders, "Fast Priority Queues for Cached Memory") for very
+// large queues of small trivially copyable items. Pushes go to a small insertion heap that
+// stays in cache. When it fills up it is sorted into a run, and runs are collected in
+// groups; once a group holds MergeArity runs they are k-way merged into one run of the next
+// group. Pops are served from a sorted deletion buffer that is refilled by merging the heads
+// of all runs. Every memory access outside the two small buffers is sequential.
+//
+// Invariant: no run holds an element that must be popped before an element still in the
+// deletion buffer, and the deletion buffer is only empty when every run is.
+//
+//     ThreadedPriorityQueue<uint64_t, std::less<uint64_t>, SequenceHeap<uint64_t>> queue;
+template <typename T, typename Comp = std::less<T>, size_t InsertCapacity = 1024, size_t MergeArity = 16>
+class SequenceHeap {
+    static_assert(std::is_trivially_copyable_v<T>, "SequenceHeap requires trivially copyable elements.");
+    static_assert(InsertCapacity > 0 && MergeArity > 1, "SequenceHeap buffer sizes are out of range.");
+
+    using RunIt = typename std::vector<T>::const_iterator;
+
+    struct Run {
+        std::vector<T> data;
+        size_t head = 0;
+    };
+
+    BinaryHeap<T, Comp> m_insert;
+    std::vector<T> m_delete; // Sorted in pop order, consumed from m_deleteHead
+    size_t m_deleteHead = 0;
+    std::vector<std::vector<Run>> m_groups;
+    size_t m_size = 0;
+
+    inline bool delete_empty() const noexcept {
+        return m_deleteHead == m_delete.size();
+    }
+
+    // True when the next pop comes from the insertion heap
+    inline bool insert_first() const {
+        if (m_insert.empty())
+            return false;
+        if (delete_empty())
+            return true;
+        return Comp{}(m_insert.top(), m_delete[m_deleteHead]);
+    }
+
+    inline void add_run(size_t group, std::vector<T>&& data) {
+        if (group == m_groups.size())
+            m_groups.emplace_back();
+
+        m_groups[group].push_back(Run{std::move(data), 0});
+        if (m_groups[group].size() < MergeArity)
+            return;
+
+        // Group full, merge its runs into one run of the next group
+        std::vector<std::pair<RunIt, RunIt>> ranges;
+        size_t total = 0;
+        for (const Run& run : m_groups[group]) {
+            ranges.emplace_back(run.data.begin() + run.head, run.data.end());
+            total += run.data.size() - run.head;
+        }
+
+        std::vector<T> merged;
+        merged.reserve(total);
+        LoserTree<RunIt, Comp>(std::move(ranges)).merge(std::back_inserter(merged));
+
+        m_groups[group].clear();
+        add_run(group + 1, std::move(merged));
+    }
+
+    // Refills the deletion buffer with the smallest heads of all runs
+    inline void refill() {
+        std::vector<std::pair<RunIt, RunIt>> ranges;
+        std::vector<Run*> owners;
+
+        for (std::vector<Run>& group : m_groups)
+            for (Run& run : group) {
+                ranges.emplace_back(run.data.begin() + run.head, run.data.end());
+                owners.push_back(&run);
+            }
+
+        m_delete.clear();
+        m_deleteHead = 0;
+        if (ranges.empty())
+            return;
+
+        LoserTree<RunIt, Comp> tree(std::move(ranges));
+        tree.merge(std::back_inserter(m_delete), InsertCapacity);
+
+        for (size_t i = 0; i < owners.size(); ++i)
+            owners[i]->head = size_t(tree.runs()[i].first - owners[i]->data.cbegin());
+
+        for (std::vector<Run>& group : m_groups)
+            group.erase(std::remove_if(group.begin(), group.end(), [](const Run& run) {
+                return run.head == run.data.size();
+            }), group.end());
+    }
+
+    // Sorts the full insertion heap into a run. The smallest part of the run and the
+    // deletion buffer stay in the deletion buffer, the rest joins group 0.
+    inline void flush() {
+        std::vector<T> flushed = m_insert.drain_sorted(1);
+        const size_t keep = m_delete.size() - m_deleteHead;
+
+        std::vector<T> merged(keep + flushed.size());
+        std::merge(m_delete.begin() + m_deleteHead, m_delete.end(), flushed.begin(), flushed.end(), merged.begin(), Comp{});
+
+        m_delete.assign(merged.begin(), merged.begin() + keep);
+        m_deleteHead = 0;
+        add_run(0, std::vector<T>(merged.begin() + keep, merged.end()));
+
+        if (delete_empty())
+            refill();
+    }
+public:
+    SequenceHeap() {
+        m_insert.reserve(InsertCapacity);
+        m_delete.reserve(InsertCapacity);
+    }
+
+    inline bool empty() const noexcept { return !m_size; }
+    inline size_t size() const noexcept { return m_size; }
+
+    inline const T& top() const {
+        return insert_first() ? m_insert.top() : m_delete[m_deleteHead];
+    }
+
+    // Runs grow on demand, the two buffers are sized at construction
+    inline void reserve(size_t) noexcept {}
+
+    inline void push(const T& item) {
+        if (m_insert.size() >= InsertCapacity)
+            flush();
+
+        m_insert.push(item);
+        ++m_size;
+    }
+
+    inline void push(T&& item) {
+        push(static_cast<const T&>(item));
+    }
+
+    template <typename... Args>
+    inline void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    inline T pop() {
+        --m_size;
+        if (insert_first())
+            return m_insert.pop();
+
+        const T temp = m_delete[m_deleteHead++];
+        if (delete_empty())
+            refill();
+
+        return temp;
+    }
+
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t) {
+        for (; first != last; ++first)
+            push(T(*first));
+    }
+
+    inline std::vector<T> drain_sorted(size_t threads) {
+        std::vector<T> out = m_insert.drain_sorted(threads);
+        out.insert(out.end(), m_delete.begin() + m_deleteHead, m_delete.end());
+
+        for (const std::vector<Run>& group : m_groups)
+            for (const Run& run : group)
+                out.insert(out.end(), run.data.begin() + run.head, run.data.end());
+
+        std::sort(out.begin(), out.end(), Comp{});
+
+        m_delete.clear();
+        m_deleteHead = 0;
+        m_groups.clear();
+        m_size = 0;
+
+        return out;
+    }
+};
+
+#endif // SEQUENCE_HEAP_H
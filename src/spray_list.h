@@ -0,0 +1,386 @@
+#ifndef SPRAY_LIST_H
+#define SPRAY_LIST_H
+
+#include "epoch_reclamation.h"
+
+#include <condition_variable>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <optional>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <new>
+
+// Relaxed concurrent priority queue after the SprayList. Elements live in a lock-free skiplist
+// (Harris-style marked next pointers), and instead of every consumer fighting for the first
+// node, a pop "sprays": it starts at a random position near the head on a high level, takes a
+// random number of steps on each level on the way down and claims the first unclaimed node it
+// lands on. The spray starts log2(threads) levels up and jumps up to relaxation * log2(threads)^3
+// nodes per level, so landings spread over the best O(threads * log2(threads)^3) elements
+// and consumers rarely collide. With threads == 1 pops are exact.
+//
+// Push and pop are lock-free. Claimed nodes are unlinked by their claimer and reclaimed
+// through an EpochDomain. The blocking calls mirror ThreadedPriorityQueue, a mutex is taken
+// only when a thread actually has to sleep or wake a sleeper.
+template <typename T, typename Comp = std::less<T>>
+class SprayList {
+    static constexpr size_t max_levels = 32;
+    static constexpr uintptr_t marked = 1;
+
+    struct Node {
+        uint64_t seq; // Breaks ties so every key is unique
+        size_t height;
+        std::atomic<bool> taken{false};
+        std::atomic<int> owners{2}; // Inserter and claimer, the last one out reclaims the node
+        union { T value; }; // Left unconstructed in the head sentinel
+        std::atomic<uintptr_t> next[1]; // Allocated with height entries
+
+        Node(uint64_t s, size_t h) : seq(s), height(h) {}
+        ~Node() {}
+    };
+
+    Node* m_head;
+    size_t m_sprayHeight;
+    size_t m_sprayJump;
+    size_t m_threads;
+
+    std::atomic<uint64_t> m_seq{0};
+    std::atomic<size_t> m_size{0};
+    mutable EpochDomain m_epochs;
+
+    // Blocking support, only touched around sleeps
+    std::condition_variable m_readCondition;
+    std::mutex m_commMutex;
+    std::atomic<size_t> m_waiters{0};
+    std::atomic<bool> m_isDone{false};
+
+    static inline Node* ptr(uintptr_t link) noexcept { return reinterpret_cast<Node*>(link & ~marked); }
+    static inline bool is_marked(uintptr_t link) noexcept { return link & marked; }
+
+    static inline Node* make_node(uint64_t seq, size_t height) {
+        void* memory = ::operator new(sizeof(Node) + (height - 1) * sizeof(std::atomic<uintptr_t>));
+        Node* node = new (memory) Node(seq, height);
+        for (size_t i = 0; i < height; ++i)
+            new (&node->next[i]) std::atomic<uintptr_t>(0);
+        return node;
+    }
+
+    static inline void free_node(void* p) noexcept {
+        Node* node = static_cast<Node*>(p);
+        node->value.~T();
+        node->~Node();
+        ::operator delete(p);
+    }
+
+    static inline uint64_t random() noexcept {
+        static thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ std::hash<std::thread::id>{}(std::this_thread::get_id());
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    static inline size_t random_height() noexcept {
+        const uint64_t bits = random() | (uint64_t(1) << (max_levels - 1));
+        size_t height = 1;
+        while (!(bits & (uint64_t(1) << (height - 1))))
+            ++height;
+        return height;
+    }
+
+    // Strict order on (value, seq)
+    static inline bool before(const Node* a, const T& value, uint64_t seq) noexcept {
+        if (Comp{}(a->value, value))
+            return true;
+        return !Comp{}(value, a->value) && a->seq < seq;
+    }
+
+    // Fills preds/succs around (value, seq) on every level, unlinking marked nodes on the way
+    inline void find(const T& value, uint64_t seq, Node** preds, Node** succs) noexcept {
+    retry:
+        Node* pred = m_head;
+        for (size_t level = max_levels; level-- > 0;) {
+            Node* curr = ptr(pred->next[level].load());
+
+            while (curr) {
+                uintptr_t succ = curr->next[level].load();
+
+                while (is_marked(succ)) {
+                    uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+                    if (!pred->next[level].compare_exchange_strong(expected, succ & ~marked))
+                        goto retry;
+
+                    curr = ptr(succ);
+                    if (!curr)
+                        break;
+                    succ = curr->next[level].load();
+                }
+
+                if (!curr || !before(curr, value, seq))
+                    break;
+
+                pred = curr;
+                curr = ptr(succ);
+            }
+
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+    }
+
+    // Drops one owner, the last one makes sure the node is unlinked and retires it
+    inline void release(Node* node) {
+        if (node->owners.fetch_sub(1) != 1)
+            return;
+
+        Node* preds[max_levels];
+        Node* succs[max_levels];
+        find(node->value, node->seq, preds, succs);
+        m_epochs.retire(node, &free_node);
+    }
+
+    inline void link(Node* node) {
+        Node* preds[max_levels];
+        Node* succs[max_levels];
+
+        while (true) {
+            find(node->value, node->seq, preds, succs);
+            for (size_t i = 0; i < node->height; ++i)
+                node->next[i].store(reinterpret_cast<uintptr_t>(succs[i]), std::memory_order_relaxed);
+
+            uintptr_t expected = reinterpret_cast<uintptr_t>(succs[0]);
+            if (preds[0]->next[0].compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node)))
+                break;
+        }
+
+        // Upper levels are an index only, linking stops early if the node is claimed meanwhile
+        for (size_t level = 1; level < node->height; ++level) {
+            while (true) {
+                uintptr_t succ = node->next[level].load();
+                if (is_marked(succ))
+                    return release(node);
+
+                if (ptr(succ) != succs[level]
+                    && !node->next[level].compare_exchange_strong(succ, reinterpret_cast<uintptr_t>(succs[level])))
+                    continue;
+
+                uintptr_t expected = reinterpret_cast<uintptr_t>(succs[level]);
+                if (preds[level]->next[level].compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node)))
+                    break;
+
+                find(node->value, node->seq, preds, succs);
+            }
+        }
+
+        release(node);
+    }
+
+    // Marks every level of a claimed node and unlinks it
+    inline void remove(Node* node) {
+        for (size_t level = node->height; level-- > 0;)
+            node->next[level].fetch_or(marked);
+
+        Node* preds[max_levels];
+        Node* succs[max_levels];
+        find(node->value, node->seq, preds, succs);
+        release(node);
+    }
+
+    // First unclaimed node at or after start on the bottom level
+    inline Node* claim_from(Node* start) noexcept {
+        for (Node* node = start; node; node = ptr(node->next[0].load())) {
+            if (node == m_head || node->taken.load(std::memory_order_relaxed))
+                continue;
+
+            bool expected = false;
+            if (node->taken.compare_exchange_strong(expected, true))
+                return node;
+        }
+        return nullptr;
+    }
+
+    inline Node* spray() noexcept {
+        Node* node = m_head;
+
+        for (size_t level = m_sprayHeight + 1; level-- > 0;) {
+            for (size_t steps = random() % (m_sprayJump + 1); steps; --steps) {
+                Node* next = ptr(node->next[level].load());
+                if (!next)
+                    break;
+                node = next;
+            }
+        }
+
+        return node;
+    }
+
+    template <typename... Args>
+    inline void push_node(Args&&... args) {
+        Node* node = make_node(m_seq.fetch_add(1, std::memory_order_relaxed), random_height());
+        try {
+            new (&node->value) T(std::forward<Args>(args)...);
+        } catch (...) {
+            node->~Node();
+            ::operator delete(node);
+            throw;
+        }
+
+        {
+            EpochDomain::Guard guard = m_epochs.pin();
+            m_size.fetch_add(1);
+            link(node);
+        }
+
+        if (m_waiters.load()) {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_readCondition.notify_all();
+        }
+    }
+
+    inline void on_popped() {
+        // Wake wait_empty_push callers once the queue drains
+        if (m_size.fetch_sub(1) == 1 && m_waiters.load()) {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_readCondition.notify_all();
+        }
+    }
+public:
+    // threads is the expected number of concurrent consumers, relaxation scales the spray width
+    // (the jump length per level, relaxation * log2(threads)^3)
+    explicit SprayList(size_t threads = std::thread::hardware_concurrency(), size_t relaxation = 1) {
+        size_t log_threads = 0;
+        while ((size_t(1) << (log_threads + 1)) <= std::max<size_t>(threads, 1))
+            ++log_threads;
+
+        m_sprayHeight = std::min(log_threads, max_levels - 1);
+        m_sprayJump = std::max<size_t>(relaxation, 1) * log_threads * log_threads * log_threads;
+        m_threads = std::max<size_t>(threads, 1);
+
+        m_head = make_node(0, max_levels);
+    }
+
+    SprayList(const SprayList&) = delete;
+    SprayList& operator=(const SprayList&) = delete;
+
+    ~SprayList() {
+        Node* node = ptr(m_head->next[0].load());
+        while (node) {
+            Node* next = ptr(node->next[0].load());
+            free_node(node);
+            node = next;
+        }
+
+        m_head->~Node();
+        ::operator delete(m_head);
+    }
+
+    // Push and pop
+    inline void push(const T& item) {
+        push_node(item);
+    }
+
+    inline void push(T&& item) {
+        push_node(std::move(item));
+    }
+
+    template <typename... Args>
+    inline void push(Args&&... args) {
+        push_node(std::forward<Args>(args)...);
+    }
+
+    // Relaxed pop, nullopt when nothing could be claimed
+    inline std::optional<T> try_pop() {
+        EpochDomain::Guard guard = m_epochs.pin();
+
+        // Landing on the very first nodes is unlikely, so about one pop in threads takes the
+        // exact front instead, which keeps the best elements from being stranded
+        Node* node = claim_from(random() % m_threads ? spray() : m_head);
+        if (!node)
+            node = claim_from(m_head); // Sprayed past the end, fall back to the exact front
+        if (!node)
+            return std::nullopt;
+
+        // Copied, concurrent traversals still compare against the value
+        std::optional<T> temp(node->value);
+        on_popped();
+        remove(node);
+
+        return temp;
+    }
+
+    inline T pop() {
+        std::optional<T> temp = try_pop();
+        if (!temp)
+            throw std::runtime_error("pop() attempted on empty priority queue.");
+
+        return std::move(*temp);
+    }
+
+    // Threaded push/pop
+    inline void wait_empty_push(T item) { // Waits til empty
+        {
+            std::unique_lock<std::mutex> lock(m_commMutex);
+            m_waiters.fetch_add(1);
+
+            // Wait until empty or done
+            m_readCondition.wait(lock, [this] {
+                return !m_size.load() || m_isDone.load();
+            });
+
+            m_waiters.fetch_sub(1);
+            if (m_isDone.load())
+                return;
+        }
+
+        push_node(std::move(item));
+    }
+
+    inline std::optional<T> wait_nonempty_pop() { // Waits til non-empty
+        while (true) {
+            if (std::optional<T> temp = try_pop())
+                return temp;
+
+            std::unique_lock<std::mutex> lock(m_commMutex);
+            m_waiters.fetch_add(1);
+
+            // Wait until non-empty or done. A push counts itself before it links the node,
+            // so a waiter may wake slightly early and retry
+            m_readCondition.wait(lock, [this] {
+                return m_size.load() || m_isDone.load();
+            });
+
+            m_waiters.fetch_sub(1);
+            if (!m_size.load() && m_isDone.load())
+                return std::nullopt;
+        }
+    }
+
+    // Strict getters
+    inline size_t size() const noexcept {
+        return m_size.load();
+    }
+
+    inline bool empty() const noexcept {
+        return !m_size.load();
+    }
+
+    // Done function
+    inline void done() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_isDone.store(true);
+        }
+
+        // Notify after unlock
+        m_readCondition.notify_all();
+    }
+
+    inline bool is_done() const noexcept {
+        return m_isDone.load();
+    }
+};
+
+#endif // SPRAY_LIST_H
@@ -2,70 +2,274 @@
 #define THREADED_PRIORITY_QUEUE_H
 
 #include <condition_variable>
+#if __has_include(<version>)
+#include <version>
+#endif
 #include <type_traits>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
 #include <optional>
+#include <atomic>
+#include <iterator>
+#include <utility>
+#include <memory>
+#include <cstdint>
 #include <cstring>
+#include <new>
 #include <thread>
+#include <vector>
 #include <mutex>
+#if defined(__cpp_lib_jthread)
+#include <stop_token>
+#endif
 
-template <typename T, typename Comp = std::less<T>>
-class ThreadedPriorityQueue {
+// Default storage policy: raw memory from the global operator new.
+//
+// A storage policy hands out the raw memory behind BinaryHeap's array through
+// allocate(bytes, alignment) and deallocate(ptr, bytes, alignment), where alignment is
+// alignof(T). Policies are held by value, so stateful ones (a NUMA node, mapping flags)
+// are passed to the BinaryHeap constructor.
+struct DefaultStorage {
+    inline void* allocate(size_t bytes, size_t alignment) {
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    inline void deallocate(void* ptr, size_t, size_t alignment) noexcept {
+        ::operator delete(ptr, std::align_val_t(alignment));
+    }
+};
+
+// Allocation granularity in bytes of a storage policy that maps whole pages, declared as
+// Storage::granularity. Array capacity is rounded up to fill it, so small growth steps do
+// not each map and fault a fresh region of which they use only a sliver.
+template <typename Storage, typename = void>
+struct storage_granularity : std::integral_constant<size_t, 1> {};
+
+template <typename Storage>
+struct storage_granularity<Storage, std::void_t<decltype(Storage::granularity)>>
+    : std::integral_constant<size_t, Storage::granularity> {};
+
+// Storage policies whose granularity is only known at run time (e.g. the page size) declare
+// a granularity() member instead
+template <typename Storage, typename = void>
+struct storage_runtime_granularity : std::false_type {};
+
+template <typename Storage>
+struct storage_runtime_granularity<Storage, std::void_t<decltype(std::declval<const Storage&>().granularity())>>
+    : std::true_type {};
+
+// Growth and shrink policy for array-backed engines. By default capacity starts at one
+// element, doubles without limit and never shrinks.
+//
+// Shrinking is enabled by a shrink_threshold: once the queue has stayed below that
+// fraction of its capacity for shrink_hysteresis consecutive pops, the capacity is cut to
+// what the next growth step from the current size would be, and to initial_capacity once the
+// queue drains. The hysteresis keeps a queue that oscillates around a size from
+// reallocating on every swing.
+struct CapacityPolicy {
+    size_t initial_capacity = 1; // First allocation of an empty engine
+    double growth_factor = 2.0; // Multiplier applied when growing, unless growth_step is set
+    size_t growth_step = 0; // Grow linearly by this many elements instead, 0 to disable
+    size_t max_step = SIZE_MAX; // Largest single growth in elements
+    size_t max_capacity = SIZE_MAX; // Hard cap, growing past it throws std::length_error
+    double shrink_threshold = 0.0; // Fraction of capacity in use below which to shrink, 0 to never shrink
+    size_t shrink_hysteresis = 1024; // Consecutive pops below the threshold before shrinking
+
+    // Capacity to grow to from capacity so that at least required elements fit
+    inline size_t grow(size_t capacity, size_t required) const {
+        if (required > max_capacity)
+            throw std::length_error("priority queue capacity limit reached.");
+
+        size_t next = initial_capacity;
+        if (capacity)
+            next = growth_step ? capacity + growth_step : size_t(double(capacity) * growth_factor);
+        if (next > capacity && next - capacity > max_step)
+            next = capacity + max_step;
+
+        return std::min(std::max({next, required, capacity + 1}), max_capacity);
+    }
+
+    inline bool below_shrink_threshold(size_t size, size_t capacity) const noexcept {
+        return shrink_threshold > 0.0 && capacity > initial_capacity && double(size) < double(capacity) * shrink_threshold;
+    }
+
+    // Capacity to shrink to, leaving room for one growth step of the current size
+    inline size_t shrink_target(size_t size) const {
+        return size ? std::max(initial_capacity, grow(size, size)) : initial_capacity;
+    }
+};
+
+// Warmup applied by an explicit reserve: touching every page of the reserved capacity up
+// front moves the page-fault cost from the first burst of pushes (inside the lock) to
+// construction. Large ranges can be touched by several threads.
+struct WarmupPolicy {
+    bool prefault = false;
+    size_t threads = 1;
+};
+
+// Runs fn(0) .. fn(threads - 1) concurrently, fn(0) on the calling thread. If starting a
+// thread or fn(0) throws, the threads already started are joined before rethrowing.
+template <typename Fn>
+inline void run_parallel(size_t threads, Fn&& fn) {
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+
+    try {
+        for (size_t t = 1; t < threads; ++t)
+            workers.emplace_back(fn, t);
+
+        fn(size_t(0));
+    } catch (...) {
+        for (std::thread& worker : workers)
+            worker.join();
+        throw;
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+// Default storage engine: an array-backed binary heap.
+//
+// An engine owns the elements and their ordering while ThreadedPriorityQueue owns the
+// locking and waiting. Engines provide empty(), size(), top(), reserve(), push(),
+// emplace(), pop(), push_bulk() and drain_sorted(), where top() and pop() are only
+// called on a non-empty engine.
+template <typename T, typename Comp = std::less<T>, typename Storage = DefaultStorage>
+class BinaryHeap {
     struct HeapVec {
         T* m_arr = nullptr;
         size_t m_size = 0, m_capacity = 0;
+        Storage m_storage;
+        CapacityPolicy m_policy;
+        size_t m_lowPops = 0; // Consecutive pops below the shrink threshold
+        size_t m_lowPopsAtShrink = 0; // m_lowPops when the last shrink in this low phase happened
 
         HeapVec() = default;
-        // Note: Freeing handled by TPQ
+        explicit HeapVec(Storage storage) : m_storage(std::move(storage)) {}
+        // Note: Freeing handled by BinaryHeap
 
+        // Slots [0, m_size) hold live elements, the rest of the array is raw memory. Elements
+        // are constructed on push and destroyed on pop, so T needs neither a default
+        // constructor nor copy operations.
         inline bool empty() const noexcept { return !m_size; }
         inline const T& front() const { return m_arr[0]; }
         inline const T& back() const { return m_arr[m_size - 1]; }
+        inline T& front() { return m_arr[0]; }
+        inline T& back() { return m_arr[m_size - 1]; }
+
+        inline T* allocate(size_t cap) {
+            return static_cast<T*>(m_storage.allocate(cap * sizeof(T), alignof(T)));
+        }
+
+        inline void deallocate(T* arr, size_t cap) noexcept {
+            m_storage.deallocate(arr, cap * sizeof(T), alignof(T));
+        }
+
+        // Moves count live elements from src to the raw array dst and ends their lifetime in src
+        static inline void relocate(T* src, size_t count, T* dst) {
+            if constexpr (std::is_trivially_copyable_v<T>) // Bitwise optimized copy for trivial types
+                memcpy(static_cast<void*>(dst), static_cast<const void*>(src), count * sizeof(T));
+            else {
+                std::uninitialized_move_n(src, count, dst);
+                std::destroy_n(src, count);
+            }
+        }
+
+        // Largest capacity that fits in the granules cap elements start using
+        inline size_t fill_granularity(size_t cap, size_t granularity) const noexcept {
+            if (granularity <= 1)
+                return cap;
+
+            const size_t bytes = (cap * sizeof(T) + granularity - 1) / granularity * granularity;
+            return std::min(bytes / sizeof(T), m_policy.max_capacity);
+        }
 
-        inline void reserve(size_t cap) noexcept {
+        inline void reserve(size_t cap) {
             if (cap <= m_capacity)
                 return;
+            if (cap > m_policy.max_capacity)
+                throw std::length_error("priority queue capacity limit reached.");
+
+            if constexpr (storage_runtime_granularity<Storage>::value)
+                cap = fill_granularity(cap, m_storage.granularity());
+            else if constexpr (storage_granularity<Storage>::value > 1)
+                cap = fill_granularity(cap, storage_granularity<Storage>::value);
 
             T* temp = m_arr;
-            m_arr = new T[cap];
+            T* arr = allocate(cap);
 
             if (temp) {
-                if constexpr (std::is_trivially_copyable_v<T>) // Bitwise optimized copy for trivial types
-                    memcpy(m_arr, temp, m_size * sizeof(T));
-                else
-                    for (size_t i = 0; i < m_size; ++i)
-                        m_arr[i] = std::move(temp[i]);
+                try {
+                    relocate(temp, m_size, arr);
+                } catch (...) {
+                    deallocate(arr, cap);
+                    throw;
+                }
                 
-                delete [] temp;
+                deallocate(temp, m_capacity);
             }
 
+            m_arr = arr;
             m_capacity = cap;
         }
 
+        // Writes every page of the unused capacity so it is faulted in
+        inline void prefault(size_t threads) {
+            constexpr size_t page = 4096;
+            char* const begin = reinterpret_cast<char*>(m_arr + m_size);
+            const size_t bytes = (m_capacity - m_size) * sizeof(T);
+
+            auto touch = [&](size_t t) {
+                volatile char* bytes_ptr = begin; // Raw memory, no element lives here
+                for (size_t offset = t * page; offset < bytes; offset += threads * page)
+                    bytes_ptr[offset] = 0;
+            };
+
+            // Below 64 MiB a single thread faults pages about as fast as it can spawn helpers
+            if (threads <= 1 || bytes < (size_t(64) << 20)) {
+                threads = 1;
+                touch(0);
+            } else
+                run_parallel(threads, touch);
+        }
+
         inline void pop_back() noexcept {
             if (m_size > 0)
-                --m_size;
+                m_arr[--m_size].~T();
+
+            if (m_policy.below_shrink_threshold(m_size, m_capacity))
+                ++m_lowPops;
+            else
+                m_lowPops = m_lowPopsAtShrink = 0;
         }
 
-        template <typename... Args>
-        inline void emplace_back(Args&&... args) noexcept {
-            if (m_size >= m_capacity)
-                reserve((m_capacity == 0) ? 1 : m_capacity * 2);
-            
-            new (m_arr + m_size++) T(std::forward<Args>(args)...); // Construct in-place
+        // Destroys every live element
+        inline void clear() noexcept {
+            std::destroy_n(m_arr, m_size);
+            m_size = 0;
         }
 
-        inline void push_back(T&& element) noexcept {
-            if (m_size >= m_capacity)
-                reserve((m_capacity == 0) ? 1 : m_capacity * 2);
+        template <typename... Args>
+        inline void emplace_back(Args&&... args) {
+            if (m_size >= m_capacity) {
+                // The arguments may refer to elements of the array about to be moved
+                T temp(std::forward<Args>(args)...);
+                reserve(m_policy.grow(m_capacity, m_size + 1));
+                new (m_arr + m_size) T(std::move(temp));
+            } else
+                new (m_arr + m_size) T(std::forward<Args>(args)...); // Construct in-place
 
-            m_arr[m_size++] = std::move(element);
+            ++m_size;
         }
 
-        inline void push_back(const T& element) noexcept {
-            if (m_size >= m_capacity)
-                reserve((m_capacity == 0) ? 1 : m_capacity * 2);
+        inline void push_back(T&& element) {
+            emplace_back(std::move(element));
+        }
 
-            m_arr[m_size++] = element;
+        inline void push_back(const T& element) {
+            emplace_back(element);
         }
 
         inline const T& operator[](const size_t i) const noexcept {
@@ -77,11 +281,7 @@ class ThreadedPriorityQueue {
         }
     };
 
-    // Private heap variables
     HeapVec m_heapVector;
-    std::condition_variable m_readCondition;
-    mutable std::mutex m_commMutex;
-    bool m_isDone = false;
 
     // Private heap functions
     inline void percolate_up(size_t index) noexcept {
@@ -122,166 +322,208 @@ class ThreadedPriorityQueue {
             index = largest_index;
         }
     }
-public:
-    ThreadedPriorityQueue() = default;
-    ThreadedPriorityQueue(const size_t reserve) { m_heapVector.reserve(reserve); }
 
-    // Disable copying and moving to prevent double-free issues due to raw pointer management
-    ThreadedPriorityQueue(const ThreadedPriorityQueue&) = delete;
-    ThreadedPriorityQueue& operator=(const ThreadedPriorityQueue&) = delete;
-    ThreadedPriorityQueue(ThreadedPriorityQueue&&) = delete;
-    ThreadedPriorityQueue& operator=(ThreadedPriorityQueue&&) = delete;
+    // Bulk operations below this size are not worth spawning threads for
+    static constexpr size_t parallel_threshold = size_t(1) << 16;
 
-    ~ThreadedPriorityQueue() {
-        if (m_heapVector.m_arr)
-            delete [] m_heapVector.m_arr;
-    }
+    // Floyd construction of the subtree rooted at root, deepest level first
+    inline void heapify_subtree(size_t root) noexcept {
+        const size_t n = m_heapVector.m_size;
 
-    // Push and pop
-    inline void push(const T& item) noexcept {
-        std::lock_guard<std::mutex> lock(m_commMutex);
-        m_heapVector.push_back(item);
-        percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
-    }
+        size_t levels = 0;
+        for (size_t first = root; first < n; first = 2 * first + 1)
+            ++levels;
 
-    inline void push(T&& item) noexcept {
-        std::lock_guard<std::mutex> lock(m_commMutex);
-        m_heapVector.push_back(std::move(item));
-        percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
-    }
+        for (size_t depth = levels; depth-- > 0;) {
+            const size_t first = ((root + 1) << depth) - 1;
+            const size_t last = std::min(first + (size_t(1) << depth), n);
 
-    template <typename... Args>
-    inline void push(Args&&... args) noexcept {
-        std::lock_guard<std::mutex> lock(m_commMutex);
-        m_heapVector.emplace_back(std::forward<Args>(args)...);
-        percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
+            for (size_t i = last; i-- > first;)
+                if (2 * i + 1 < n)
+                    percolate_down(i);
+        }
     }
-    
-    inline T pop() {
-        std::lock_guard<std::mutex> lock(m_commMutex);
-        if (m_heapVector.empty())
-            throw std::runtime_error("pop() attempted on empty priority queue.");
 
-        T temp = std::move(m_heapVector.front());
-        
-        if (m_heapVector.m_size > 1) {
-            m_heapVector[0] = std::move(m_heapVector.back());
-            m_heapVector.pop_back();
-            percolate_down(0);
-        } else
-            m_heapVector.pop_back();
-        
-        // Notify if the queue became empty, as this state is used by wait_empty_push
-        if (m_heapVector.empty())
-            m_readCondition.notify_one();
-        
-        return temp;
+    // Floyd's bottom-up heap construction. Subtrees rooted at the same level are
+    // independent, so they are heapified concurrently before the levels above them are
+    // fixed up on the calling thread.
+    inline void heapify(size_t threads) noexcept {
+        const size_t n = m_heapVector.m_size;
+
+        if (n < parallel_threshold || threads <= 1) {
+            for (size_t i = n / 2; i-- > 0;)
+                percolate_down(i);
+            return;
+        }
+
+        // Split level with about four subtrees per thread to even out the ragged last level
+        size_t depth = 0;
+        while ((size_t(1) << depth) < threads * 4)
+            ++depth;
+
+        const size_t first_root = (size_t(1) << depth) - 1;
+        const size_t roots = size_t(1) << depth;
+
+        run_parallel(threads, [&](size_t t) {
+            for (size_t root = first_root + t; root < first_root + roots; root += threads)
+                heapify_subtree(root);
+        });
+
+        for (size_t i = first_root; i-- > 0;)
+            percolate_down(i);
     }
 
-    // Threaded push/pop
-    inline void wait_empty_push(const T& item) { // Waits til empty
-        std::unique_lock<std::mutex> lock(m_commMutex);
-        
-        // Wait until empty or done
-        m_readCondition.wait(lock, [this] {
-            return m_heapVector.empty() || m_isDone;
+    // Sample sort of the heap array into out (sized to match). Splitters are picked from an
+    // evenly spaced sample, every thread classifies and scatters its own chunk, and each
+    // bucket is then sorted on its own thread.
+    inline void sample_sort_into(std::vector<T>& out, size_t threads) {
+        T* src = m_heapVector.m_arr;
+        const size_t n = m_heapVector.m_size;
+        const size_t buckets = threads;
+
+        constexpr size_t oversample = 32;
+        std::vector<const T*> sample(buckets * oversample);
+        for (size_t i = 0; i < sample.size(); ++i)
+            sample[i] = src + i * n / sample.size();
+
+        std::sort(sample.begin(), sample.end(), [](const T* a, const T* b) { return Comp{}(*a, *b); });
+
+        std::vector<const T*> splitters(buckets - 1);
+        for (size_t b = 1; b < buckets; ++b)
+            splitters[b - 1] = sample[b * oversample];
+
+        std::vector<uint32_t> bucket_of(n);
+        std::vector<size_t> counts(threads * buckets, 0), offsets(threads * buckets);
+        std::vector<size_t> bucket_start(buckets + 1);
+
+        run_parallel(threads, [&](size_t t) {
+            size_t* count = &counts[t * buckets];
+
+            for (size_t i = t * n / threads; i < (t + 1) * n / threads; ++i) {
+                const auto it = std::upper_bound(splitters.begin(), splitters.end(), src + i,
+                    [](const T* a, const T* b) { return Comp{}(*a, *b); });
+
+                bucket_of[i] = uint32_t(it - splitters.begin());
+                ++count[bucket_of[i]];
+            }
         });
 
-        if (m_isDone)
-            return;
+        // Bucket-major offsets keep every bucket contiguous in out
+        size_t pos = 0;
+        for (size_t b = 0; b < buckets; ++b) {
+            bucket_start[b] = pos;
+            for (size_t t = 0; t < threads; ++t) {
+                offsets[t * buckets + b] = pos;
+                pos += counts[t * buckets + b];
+            }
+        }
+        bucket_start[buckets] = n;
 
-        m_heapVector.push_back(item);
-        percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
-    }
+        run_parallel(threads, [&](size_t t) {
+            size_t* offset = &offsets[t * buckets];
 
-    inline void wait_empty_push(T&& item) { // Waits til empty
-        std::unique_lock<std::mutex> lock(m_commMutex);
-        
-        // Wait until empty or done
-        m_readCondition.wait(lock, [this] {
-            return m_heapVector.empty() || m_isDone;
+            for (size_t i = t * n / threads; i < (t + 1) * n / threads; ++i)
+                out[offset[bucket_of[i]]++] = std::move(src[i]);
         });
 
-        if (m_isDone)
-            return;
+        run_parallel(buckets, [&](size_t b) {
+            std::sort(out.begin() + bucket_start[b], out.begin() + bucket_start[b + 1], Comp{});
+        });
+    }
+public:
+    BinaryHeap() = default;
+    explicit BinaryHeap(Storage storage, size_t reserve = 0) : m_heapVector(std::move(storage)) {
+        m_heapVector.reserve(reserve);
+    }
 
-        m_heapVector.push_back(std::move(item));
-        percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
+    // Disable copying and moving to prevent double-free issues due to raw pointer management
+    BinaryHeap(const BinaryHeap&) = delete;
+    BinaryHeap& operator=(const BinaryHeap&) = delete;
+    BinaryHeap(BinaryHeap&&) = delete;
+    BinaryHeap& operator=(BinaryHeap&&) = delete;
+
+    ~BinaryHeap() {
+        if (m_heapVector.m_arr) {
+            m_heapVector.clear();
+            m_heapVector.deallocate(m_heapVector.m_arr, m_heapVector.m_capacity);
+        }
     }
 
-    template <typename... Args>
-    inline void wait_empty_push(Args&&... args) { // Waits til empty
-        std::unique_lock<std::mutex> lock(m_commMutex);
-        
-        // Wait until empty or done
-        m_readCondition.wait(lock, [this] {
-            return m_heapVector.empty() || m_isDone;
-        });
+    inline bool empty() const noexcept { return m_heapVector.empty(); }
+    inline size_t size() const noexcept { return m_heapVector.m_size; }
+    inline const T& top() const noexcept { return m_heapVector.front(); }
+    inline void reserve(size_t cap) { m_heapVector.reserve(cap); }
 
-        if (m_isDone)
-            return;
+    // Destroys every element, the capacity is kept
+    inline void clear() noexcept { m_heapVector.clear(); }
 
-        m_heapVector.emplace_back(std::forward<Args>(args)...);
-        percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
+    inline void reserve(size_t cap, const WarmupPolicy& warmup) {
+        m_heapVector.reserve(cap);
+        if (warmup.prefault)
+            m_heapVector.prefault(std::max<size_t>(warmup.threads, 1));
     }
 
-    inline std::optional<T> wait_nonempty_pop() { // Waits til non-empty
-        std::unique_lock<std::mutex> lock(m_commMutex);
-        
-        // Wait until non-empty or done
-        m_readCondition.wait(lock, [this] {
-            return !m_heapVector.empty() || m_isDone;
-        });
+    inline const CapacityPolicy& capacity_policy() const noexcept { return m_heapVector.m_policy; }
+    inline void set_capacity_policy(const CapacityPolicy& policy) noexcept { m_heapVector.m_policy = policy; }
+    inline size_t capacity() const noexcept { return m_heapVector.m_capacity; }
 
-        if (m_heapVector.empty())
-            return std::nullopt;
+    // Bytes held by the element array
+    inline size_t memory_usage() const noexcept { return m_heapVector.m_capacity * sizeof(T); }
 
-        T temp = std::move(m_heapVector.front());
-        
-        if (m_heapVector.m_size > 1) {
-            m_heapVector[0] = std::move(m_heapVector.back());
-            m_heapVector.pop_back();
-            percolate_down(0);
-        } else
-            m_heapVector.pop_back();
-        
-        // Notify if the queue became empty, as this state is used by wait_empty_push
-        if (m_heapVector.empty())
-            m_readCondition.notify_one();
+    // Shrinking in three steps so the caller can allocate and free outside its lock:
+    // shrink_request() names the capacity to shrink to (0 if none is due), the buffer is
+    // allocated with allocate_buffer(), swapped in by adopt_buffer() under the lock, and
+    // whatever adopt_buffer() returns is released with release_buffer() afterwards.
+    inline size_t shrink_request() const {
+        const HeapVec& vec = m_heapVector;
+        const size_t hysteresis = vec.m_policy.shrink_hysteresis;
 
-        return std::make_optional<T>(std::move(temp));
+        // A shrink is due after hysteresis low pops, counted again after each shrink. Once the
+        // queue drains, a low phase that already lasted that long goes straight to the floor.
+        if (vec.m_lowPops < hysteresis || (vec.m_size && vec.m_lowPops - vec.m_lowPopsAtShrink < hysteresis))
+            return 0;
+        if constexpr (!std::is_nothrow_move_constructible_v<T>)
+            return 0; // adopt_buffer() could not move the elements without risking them
+
+        const size_t target = vec.m_policy.shrink_target(vec.m_size);
+        return target < vec.m_capacity ? target : 0;
     }
 
-    // Strictly nonthreaded push/pop (unsafe)
-    inline void unsafe_push(const T& item) noexcept {
+    inline T* allocate_buffer(size_t cap) { return m_heapVector.allocate(cap); }
+    inline void release_buffer(T* arr, size_t cap) noexcept { m_heapVector.deallocate(arr, cap); }
+
+    // Moves the elements into arr if they fit and it is smaller, returns the buffer to release
+    inline std::pair<T*, size_t> adopt_buffer(T* arr, size_t cap) noexcept {
+        HeapVec& vec = m_heapVector;
+        if (vec.m_size > cap || cap >= vec.m_capacity)
+            return {arr, cap}; // Grew or shrank meanwhile
+
+        HeapVec::relocate(vec.m_arr, vec.m_size, arr); // Only requested for nothrow moves
+
+        std::pair<T*, size_t> old{vec.m_arr, vec.m_capacity};
+        vec.m_arr = arr;
+        vec.m_capacity = cap;
+        vec.m_lowPopsAtShrink = vec.m_lowPops;
+        return old;
+    }
+
+    inline void push(const T& item) {
         m_heapVector.push_back(item);
         percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
     }
 
-    inline void unsafe_push(T&& item) noexcept {
+    inline void push(T&& item) {
         m_heapVector.push_back(std::move(item));
         percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
     }
 
     template <typename... Args>
-    inline void unsafe_push(Args&&... args) noexcept {
+    inline void emplace(Args&&... args) {
         m_heapVector.emplace_back(std::forward<Args>(args)...);
         percolate_up(m_heapVector.m_size - 1);
-        m_readCondition.notify_one();
     }
 
-    inline T unsafe_pop() {
-        if (m_heapVector.empty())
-            throw std::runtime_error("pop() attempted on empty priority queue.");
-
+    inline T pop() {
         T temp = std::move(m_heapVector.front());
         
         if (m_heapVector.m_size > 1) {
@@ -290,57 +532,1299 @@ public:
             percolate_down(0);
         } else
             m_heapVector.pop_back();
-        
-        // Notify if the queue became empty, as this state is used by wait_empty_push
-        if (m_heapVector.empty())
-            m_readCondition.notify_one();
-        
+
         return temp;
     }
 
-    // Strict getters
-    inline const T& top() const {
-        std::lock_guard<std::mutex> lock(m_commMutex);
-        if (m_heapVector.empty())
-            throw std::runtime_error("top() attempted on empty priority queue.");
+    // Appends a range. Large batches rebuild the heap with (parallel) Floyd construction,
+    // small ones are sifted up one by one.
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t threads) {
+        const size_t old_size = m_heapVector.m_size;
+
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>)
+            m_heapVector.reserve(old_size + size_t(std::distance(first, last)));
+
+        // Drops the unsifted tail if an element or the storage throws, keeping the heap intact
+        try {
+            for (; first != last; ++first)
+                m_heapVector.emplace_back(*first);
+        } catch (...) {
+            std::destroy_n(m_heapVector.m_arr + old_size, m_heapVector.m_size - old_size);
+            m_heapVector.m_size = old_size;
+            throw;
+        }
 
-        return m_heapVector.front();
+        const size_t added = m_heapVector.m_size - old_size;
+        if (added * 4 >= m_heapVector.m_size)
+            heapify(threads);
+        else
+            for (size_t i = old_size; i < m_heapVector.m_size; ++i)
+                percolate_up(i);
     }
 
-    inline size_t size() const noexcept {
-        return m_heapVector.m_size;
+    // Moves every element out in pop order, sorting in parallel for large heaps. The
+    // parallel scatter writes into pre-sized output, so it needs default-constructible T.
+    inline std::vector<T> drain_sorted(size_t threads) {
+        const size_t n = m_heapVector.m_size;
+        std::vector<T> out;
+
+        if constexpr (std::is_default_constructible_v<T>)
+            if (n >= parallel_threshold && threads > 1) {
+                out.resize(n);
+                sample_sort_into(out, threads);
+                m_heapVector.clear();
+                return out;
+            }
+
+        out.reserve(n);
+        std::move(m_heapVector.m_arr, m_heapVector.m_arr + n, std::back_inserter(out));
+        std::sort(out.begin(), out.end(), Comp{});
+
+        m_heapVector.clear();
+        return out;
     }
+};
 
-    inline bool empty() const noexcept {
-        return m_heapVector.empty();
+// Bounded lock-free MPMC pool of spare objects (Vyukov's array queue). Consumers hand
+// processed items back with put() and producers take() them to refill instead of
+// allocating, so buffers held by the items stay allocated and warm. put() fails when the
+// pool is full, take() when it is empty.
+template <typename T>
+class RecyclePool {
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_enqueue{0};
+    alignas(64) std::atomic<size_t> m_dequeue{0};
+
+    static inline T* item(Cell& cell) noexcept {
+        return std::launder(reinterpret_cast<T*>(cell.bytes));
     }
+public:
+    // Capacity is rounded up to a power of two
+    explicit RecyclePool(size_t capacity) {
+        size_t cells = 2;
+        while (cells < capacity)
+            cells *= 2;
 
-    // Threaded getters
-    inline std::optional<T> wait_and_get_top() const {
-        std::unique_lock<std::mutex> lock(m_commMutex);
-        m_readCondition.wait(lock, [this] {
-            return !m_heapVector.empty() || m_isDone;
-        });
+        m_cells = std::make_unique<Cell[]>(cells);
+        m_mask = cells - 1;
+        for (size_t i = 0; i < cells; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
 
-        if (m_heapVector.empty())
-            return std::nullopt;
+    RecyclePool(const RecyclePool&) = delete;
+    RecyclePool& operator=(const RecyclePool&) = delete;
 
-        return std::make_optional<T>(m_heapVector.front());
+    ~RecyclePool() {
+        while (take()) {}
     }
 
-    // Done function
-    inline void done() noexcept {
-        {
-            std::lock_guard<std::mutex> lock(m_commMutex);
-            m_isDone = true;
+    inline size_t capacity() const noexcept { return m_mask + 1; }
+
+    inline bool put(T&& value) {
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = m_cells[pos & m_mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+
+            if (diff == 0) {
+                if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (cell.bytes) T(std::move(value));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0)
+                return false; // Full
+            else
+                pos = m_enqueue.load(std::memory_order_relaxed);
         }
+    }
 
-        // Notify after unlock
-        m_readCondition.notify_all();
+    inline std::optional<T> take() {
+        size_t pos = m_dequeue.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = m_cells[pos & m_mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+
+            if (diff == 0) {
+                if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* stored = item(cell);
+                    std::optional<T> temp(std::move(*stored));
+                    stored->~T();
+                    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return temp;
+                }
+            } else if (diff < 0)
+                return std::nullopt; // Empty
+            else
+                pos = m_dequeue.load(std::memory_order_relaxed);
+        }
     }
+};
 
-    inline bool is_done() const noexcept {
-        return m_isDone;
+// Soft flow control for ThreadedPriorityQueue::set_watermarks(). Once size() reaches high the
+// queue counts as throttled and on_high runs; once it falls back to low or below it is
+// released and on_low runs. Callbacks run on the pushing/popping thread after the lock is
+// released, so they may call back into the queue. They start in crossing order and
+// alternate, a crossing superseded by a later one before it was delivered is dropped. No
+// lock is held while one runs, so on_high may block until on_low has run on another thread.
+struct Watermarks {
+    size_t high = SIZE_MAX;
+    size_t low = 0;
+    std::function<void()> on_high;
+    std::function<void()> on_low;
+};
+
+// Engines that can shrink their storage outside the queue's lock (see BinaryHeap::shrink_request)
+template <typename Engine, typename = void>
+struct engine_shrinks : std::false_type {};
+
+template <typename Engine>
+struct engine_shrinks<Engine, std::void_t<decltype(std::declval<Engine&>().shrink_request())>> : std::true_type {};
+
+// Engines that can destroy their elements and keep their storage
+template <typename Engine, typename = void>
+struct engine_clears : std::false_type {};
+
+template <typename Engine>
+struct engine_clears<Engine, std::void_t<decltype(std::declval<Engine&>().clear())>> : std::true_type {};
+
+template <typename T, typename Comp = std::less<T>, typename Engine = BinaryHeap<T, Comp>>
+class ThreadedPriorityQueue {
+    // State a waiter is waiting for
+    enum class WaitFor { NonEmpty, Empty, Drained };
+
+    // Waiter that can be cancelled through a stop_token. Each one sleeps on its own
+    // condition variable so a stop request wakes only that waiter. Linked into
+    // m_tokenWaiters under m_commMutex for as long as it waits.
+    struct TokenWaiter {
+        std::condition_variable cv;
+        WaitFor event;
+        bool notified = false; // Woken but not yet running, so notify_one picks another waiter
+        TokenWaiter* prev = nullptr;
+        TokenWaiter* next = nullptr;
+
+        explicit TokenWaiter(WaitFor e) : event(e) {}
+    };
+
+    // Watermark crossing found under the lock, fired after unlocking
+    struct WatermarkEvent {
+        std::shared_ptr<const Watermarks> marks; // Null when nothing was crossed
+        bool high = false;
+        uint64_t seq = 0; // Order of the crossing, see deliver_watermark()
+        ThreadedPriorityQueue* queue = nullptr;
+
+        inline void fire() const {
+            if (marks)
+                queue->deliver_watermark(*this);
+        }
+    };
+
+    // Private heap variables
+    Engine m_engine;
+    mutable std::condition_variable m_readCondition;
+    mutable std::mutex m_commMutex;
+    bool m_isDone = false;
+    std::atomic<RecyclePool<T>*> m_recycle{nullptr}; // Created on first use
+    mutable TokenWaiter* m_tokenWaiters = nullptr;
+    mutable std::atomic<size_t> m_tokenWaiterCount{0};
+    mutable size_t m_waiters = 0; // Threads blocked on m_readCondition, guarded by m_commMutex
+
+    // Drain-then-stop state. close() moves the backlog into m_drained in pop order and
+    // consumers claim it through m_drainCursor without the lock.
+    std::atomic<bool> m_isClosed{false};
+    std::vector<T> m_drained;
+    std::atomic<size_t> m_drainCursor{0};
+    std::atomic<size_t> m_drainTaken{0}; // Elements moved out of m_drained so far
+    mutable std::atomic<size_t> m_drainClaims{0}; // take_drained() and drained_top() calls in progress
+    mutable std::atomic<size_t> m_drainPeeks{0}; // drained_top() copies in progress
+
+    // Watermarks, the limits are copied out so the check under the lock is two compares
+    std::shared_ptr<const Watermarks> m_watermarks;
+    size_t m_highWatermark = SIZE_MAX;
+    size_t m_lowWatermark = 0;
+    std::atomic<bool> m_isThrottled{false};
+    uint64_t m_watermarkSeq = 0; // Crossings so far, m_commMutex held
+
+    // Callback delivery. Each callback to run takes a turn and starts once the previous
+    // turn has started; the lock only covers that bookkeeping, never a callback.
+    std::mutex m_watermarkMutex;
+    std::condition_variable m_watermarkTurn;
+    uint64_t m_watermarkDelivered = 0; // Newest crossing seen by deliver_watermark()
+    bool m_watermarkHigh = false; // Kind of the last callback given a turn
+    uint64_t m_watermarkTurns = 0;
+    uint64_t m_watermarkStarted = 0;
+
+    // Runs event's callback unless a later crossing was seen first or the last callback
+    // was of the same kind, so callbacks start in the order the crossings happened in
+    inline void deliver_watermark(const WatermarkEvent& event) {
+        std::unique_lock<std::mutex> lock(m_watermarkMutex);
+        if (event.seq <= m_watermarkDelivered)
+            return;
+
+        m_watermarkDelivered = event.seq;
+        if (event.high == m_watermarkHigh)
+            return;
+
+        m_watermarkHigh = event.high;
+        const uint64_t turn = ++m_watermarkTurns;
+        m_watermarkTurn.wait(lock, [this, turn] { return m_watermarkStarted + 1 == turn; });
+        m_watermarkStarted = turn;
+        lock.unlock();
+        m_watermarkTurn.notify_all();
+
+        const std::function<void()>& callback = event.high ? event.marks->on_high : event.marks->on_low;
+        if (callback)
+            callback();
+    }
+
+    // Wakes one waiter for event, m_commMutex held
+    inline void notify_one(WaitFor event) {
+        m_readCondition.notify_one();
+        notify_token_one(event);
+    }
+
+    // Wakes one token waiter for event, m_commMutex held
+    inline void notify_token_one(WaitFor event) {
+        for (TokenWaiter* waiter = m_tokenWaiters; waiter; waiter = waiter->next)
+            if (waiter->event == event && !waiter->notified) {
+                waiter->notified = true;
+                waiter->cv.notify_one();
+                break;
+            }
+    }
+
+    // Wakes every waiter, m_commMutex held
+    inline void notify_all_locked() {
+        m_readCondition.notify_all();
+
+        for (TokenWaiter* waiter = m_tokenWaiters; waiter; waiter = waiter->next) {
+            waiter->notified = true;
+            waiter->cv.notify_one();
+        }
+    }
+
+    // Wakes every waiter, m_commMutex not held. Token waiters are only locked for when present.
+    inline void notify_all_unlocked() {
+        m_readCondition.notify_all();
+
+        if (m_tokenWaiterCount.load()) {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            notify_all_locked();
+        }
+    }
+
+    // Waits on waiter's own condition variable until pred holds or a stop is requested,
+    // returns pred(). The caller has registered a stop_callback that notifies waiter.cv
+    // under m_commMutex.
+    template <typename Token, typename Pred>
+    inline bool wait_token(std::unique_lock<std::mutex>& lock, const Token& token, TokenWaiter& waiter, Pred pred) const {
+        waiter.next = m_tokenWaiters;
+        if (m_tokenWaiters)
+            m_tokenWaiters->prev = &waiter;
+        m_tokenWaiters = &waiter;
+        m_tokenWaiterCount.fetch_add(1);
+
+        while (!pred() && !token.stop_requested()) {
+            waiter.notified = false;
+            waiter.cv.wait(lock);
+        }
+
+        if (waiter.prev)
+            waiter.prev->next = waiter.next;
+        else
+            m_tokenWaiters = waiter.next;
+        if (waiter.next)
+            waiter.next->prev = waiter.prev;
+        m_tokenWaiterCount.fetch_sub(1);
+
+        return pred();
+    }
+
+    // Checks the watermarks after the engine's size changed, m_commMutex held
+    inline WatermarkEvent check_watermarks() {
+        const size_t size = m_engine.size();
+        const bool throttled = m_isThrottled.load(std::memory_order_relaxed);
+
+        if (throttled ? size > m_lowWatermark : size < m_highWatermark)
+            return WatermarkEvent();
+
+        m_isThrottled.store(!throttled);
+        return WatermarkEvent{m_watermarks, !throttled, ++m_watermarkSeq, this};
+    }
+
+    inline void throw_if_closed() const {
+        if (m_isClosed.load(std::memory_order_relaxed))
+            throw std::runtime_error("push() attempted on closed priority queue.");
+    }
+
+    // Marks a take_drained() or drained_top() call in progress. Counted before the closed
+    // check, see throw_if_busy().
+    struct DrainClaim {
+        std::atomic<size_t>& claims;
+
+        explicit DrainClaim(std::atomic<size_t>& c) : claims(c) { claims.fetch_add(1); }
+        ~DrainClaim() { claims.fetch_sub(1); }
+    };
+
+    // Counts elements moved out of the drain buffer, the last claimer wakes wait_drained()
+    inline void drained_taken(size_t count) {
+        if (m_drainTaken.fetch_add(count) + count == m_drained.size()) {
+            { std::lock_guard<std::mutex> lock(m_commMutex); } // Orders it after a waiter's check
+            notify_all_unlocked();
+        }
+    }
+
+    // Called by a claimer after advancing the cursor. A drained_top() that read the cursor
+    // before it may still be copying one of the claimed slots, later ones see the cursor
+    // past them. Peeks are rare and short, so this rarely spins.
+    inline void wait_drain_peeks() const noexcept {
+        while (m_drainPeeks.load())
+            std::this_thread::yield();
+    }
+
+    // Moves up to max elements of the drain buffer into out, nothing unless closed
+    inline void take_drained(size_t max, std::vector<T>& out) {
+        const DrainClaim claim(m_drainClaims);
+        if (!m_isClosed.load())
+            return;
+
+        const size_t total = m_drained.size();
+        if (m_drainCursor.load(std::memory_order_relaxed) >= total)
+            return;
+
+        max = std::min(max, total); // Keeps the cursor from wrapping
+        const size_t first = std::min(m_drainCursor.fetch_add(max), total);
+        const size_t last = total - first < max ? total : first + max;
+        if (first == last)
+            return;
+
+        wait_drain_peeks();
+
+        out.reserve(out.size() + (last - first));
+        std::move(m_drained.begin() + first, m_drained.begin() + last, std::back_inserter(out));
+        drained_taken(last - first);
+    }
+
+    // Single claim, nullopt unless closed with elements left
+    inline std::optional<T> take_drained() {
+        const DrainClaim claim(m_drainClaims);
+        if (!m_isClosed.load())
+            return std::nullopt;
+
+        const size_t total = m_drained.size();
+        if (m_drainCursor.load(std::memory_order_relaxed) >= total)
+            return std::nullopt;
+
+        const size_t index = m_drainCursor.fetch_add(1);
+        if (index >= total)
+            return std::nullopt;
+
+        wait_drain_peeks();
+
+        std::optional<T> temp(std::move(m_drained[index]));
+        drained_taken(1);
+        return temp;
+    }
+
+    // Copy of the first unclaimed element of a closed queue's backlog, nullopt if none.
+    // Claimers of that slot wait in wait_drain_peeks() until the copy is done.
+    inline std::optional<T> drained_top() const {
+        const DrainClaim claim(m_drainClaims);
+        if (!m_isClosed.load())
+            return std::nullopt;
+
+        const DrainClaim peek(m_drainPeeks);
+        const size_t index = m_drainCursor.load();
+        if (index >= m_drained.size())
+            return std::nullopt;
+
+        return std::make_optional<T>(m_drained[index]);
+    }
+
+    // Pops up to max elements of the non-empty engine, then unlocks
+    inline std::vector<T> pop_batch_locked(std::unique_lock<std::mutex>& lock, size_t max) {
+        std::vector<T> out;
+        out.reserve(std::min(max, m_engine.size()));
+        while (out.size() < max && !m_engine.empty())
+            out.push_back(m_engine.pop());
+
+        // Notify if the queue became empty, as this state is used by wait_empty_push
+        if (m_engine.empty())
+            notify_one(WaitFor::Empty);
+
+        const size_t shrink = shrink_request();
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        shrink_unlocked(shrink);
+        event.fire();
+
+        return out;
+    }
+
+    // Throws std::logic_error while a thread waits on the queue or claims from the drain
+    // buffer, m_commMutex held. Otherwise the queue is left open and returns whether it was
+    // closed. The closed flag is cleared before the claims are read and stays clear, so a
+    // pop() that starts afterwards blocks on the lock instead of claiming from m_drained
+    // while the caller moves or clears it.
+    inline bool throw_if_busy(const char* message) {
+        if (m_waiters || m_tokenWaiterCount.load())
+            throw std::logic_error(message);
+
+        if (!m_isClosed.load())
+            return false;
+
+        m_isClosed.store(false);
+        if (m_drainClaims.load()) {
+            m_isClosed.store(true);
+            throw std::logic_error(message);
+        }
+        return true;
+    }
+
+    // Forgets a closed queue's backlog, m_commMutex held and throw_if_busy() passed
+    inline void reset_drain() noexcept {
+        m_drained.clear();
+        m_drainCursor.store(0);
+        m_drainTaken.store(0);
+        m_isClosed.store(false);
+    }
+
+    inline RecyclePool<T>& recycle_pool(size_t capacity = default_recycle_capacity) {
+        RecyclePool<T>* pool = m_recycle.load(std::memory_order_acquire);
+        if (pool)
+            return *pool;
+
+        // Racing creators keep the first pool published
+        RecyclePool<T>* created = new RecyclePool<T>(capacity);
+        if (m_recycle.compare_exchange_strong(pool, created, std::memory_order_acq_rel))
+            return *created;
+
+        delete created;
+        return *pool;
+    }
+
+    // Shrinks to target capacity with the allocation and the release outside the lock.
+    // Called without the lock held, after a pop under it returned a shrink request.
+    inline void shrink_unlocked(size_t target) {
+        if constexpr (engine_shrinks<Engine>::value) {
+            if (!target)
+                return;
+
+            // Shrinking is an optimization, a failed allocation just keeps the larger buffer
+            decltype(m_engine.allocate_buffer(target)) buffer;
+            try {
+                buffer = m_engine.allocate_buffer(target);
+            } catch (...) {
+                return;
+            }
+
+            std::pair<decltype(buffer), size_t> released;
+            {
+                std::lock_guard<std::mutex> lock(m_commMutex);
+                released = m_engine.adopt_buffer(buffer, target);
+            }
+
+            m_engine.release_buffer(released.first, released.second);
+        }
+    }
+
+    inline size_t shrink_request() const {
+        if constexpr (engine_shrinks<Engine>::value)
+            return m_engine.shrink_request();
+        else
+            return 0;
+    }
+#if defined(__cpp_lib_jthread)
+    template <typename... Args>
+    inline bool wait_empty_emplace(std::stop_token token, Args&&... args) {
+        TokenWaiter waiter(WaitFor::Empty);
+        std::stop_callback wake(token, [this, &waiter] {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            waiter.cv.notify_one();
+        });
+
+        std::unique_lock<std::mutex> lock(m_commMutex);
+
+        // Wait until empty or done
+        if (!wait_token(lock, token, waiter, [this] { return m_engine.empty() || m_isDone; }) || m_isDone)
+            return false;
+
+        throw_if_closed();
+        m_engine.emplace(std::forward<Args>(args)...);
+        notify_one(WaitFor::NonEmpty);
+
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        event.fire();
+        return true;
+    }
+#endif
+public:
+    static constexpr size_t default_recycle_capacity = 1024;
+
+    // Popped element that returns to the queue's recycle pool when it goes out of scope,
+    // unless release()d. Empty (false) when the queue was done. Must not outlive the queue.
+    class Recycled {
+        friend class ThreadedPriorityQueue;
+        std::optional<T> m_value;
+        RecyclePool<T>* m_pool = nullptr;
+
+        Recycled() = default;
+        Recycled(T&& value, RecyclePool<T>* pool) : m_value(std::move(value)), m_pool(pool) {}
+    public:
+        Recycled(const Recycled&) = delete;
+        Recycled& operator=(const Recycled&) = delete;
+
+        Recycled(Recycled&& other) noexcept : m_value(std::move(other.m_value)), m_pool(other.m_pool) {
+            other.m_value.reset();
+        }
+
+        ~Recycled() {
+            if (m_value)
+                m_pool->put(std::move(*m_value)); // Dropped when the pool is full
+        }
+
+        inline explicit operator bool() const noexcept { return m_value.has_value(); }
+
+        inline T& operator*() noexcept { return *m_value; }
+        inline const T& operator*() const noexcept { return *m_value; }
+        inline T* operator->() noexcept { return &*m_value; }
+        inline const T* operator->() const noexcept { return &*m_value; }
+
+        // Keeps the element instead of recycling it
+        inline T release() {
+            T temp = std::move(*m_value);
+            m_value.reset();
+            return temp;
+        }
+    };
+
+    ThreadedPriorityQueue() = default;
+    ThreadedPriorityQueue(const size_t reserve) { m_engine.reserve(reserve); }
+
+    // Reserves with an explicit growth policy and optional page warmup (array-backed engines)
+    ThreadedPriorityQueue(const size_t reserve, const CapacityPolicy& policy, const WarmupPolicy& warmup = WarmupPolicy()) {
+        m_engine.set_capacity_policy(policy);
+        m_engine.reserve(reserve, warmup);
+    }
+
+    ThreadedPriorityQueue(const size_t reserve, const WarmupPolicy& warmup) { m_engine.reserve(reserve, warmup); }
+
+    // Constructs the engine from args, e.g. BinaryHeap with a stateful storage policy
+    template <typename... EngineArgs>
+    explicit ThreadedPriorityQueue(std::in_place_t, EngineArgs&&... args) : m_engine(std::forward<EngineArgs>(args)...) {}
+
+    // Disable copying and moving, the engine and synchronization state are not transferable
+    ThreadedPriorityQueue(const ThreadedPriorityQueue&) = delete;
+    ThreadedPriorityQueue& operator=(const ThreadedPriorityQueue&) = delete;
+    ThreadedPriorityQueue(ThreadedPriorityQueue&&) = delete;
+    ThreadedPriorityQueue& operator=(ThreadedPriorityQueue&&) = delete;
+
+    ~ThreadedPriorityQueue() {
+        delete m_recycle.load();
+    }
+
+    // Push and pop
+    inline void push(const T& item) {
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            throw_if_closed();
+            m_engine.push(item);
+            notify_one(WaitFor::NonEmpty);
+            event = check_watermarks();
+        }
+        event.fire();
+    }
+
+    inline void push(T&& item) {
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            throw_if_closed();
+            m_engine.push(std::move(item));
+            notify_one(WaitFor::NonEmpty);
+            event = check_watermarks();
+        }
+        event.fire();
+    }
+
+    template <typename... Args>
+    inline void push(Args&&... args) {
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            throw_if_closed();
+            m_engine.emplace(std::forward<Args>(args)...);
+            notify_one(WaitFor::NonEmpty);
+            event = check_watermarks();
+        }
+        event.fire();
+    }
+    
+    inline T pop() {
+        // After close() the backlog is claimed without the lock
+        if (m_isClosed.load(std::memory_order_acquire)) {
+            if (std::optional<T> temp = take_drained())
+                return std::move(*temp);
+            throw std::runtime_error("pop() attempted on empty priority queue.");
+        }
+
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        if (m_engine.empty()) {
+            lock.unlock();
+            if (std::optional<T> temp = take_drained()) // Closed meanwhile
+                return std::move(*temp);
+            throw std::runtime_error("pop() attempted on empty priority queue.");
+        }
+
+        T temp = m_engine.pop();
+        
+        // Notify if the queue became empty, as this state is used by wait_empty_push
+        if (m_engine.empty())
+            notify_one(WaitFor::Empty);
+
+        const size_t shrink = shrink_request();
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        shrink_unlocked(shrink);
+        event.fire();
+        
+        return temp;
+    }
+
+    // Bulk push, one lock acquisition for the whole range. Large loads are heapified
+    // using up to `threads` threads.
+    template <typename It>
+    inline void push_bulk(It first, It last, size_t threads = std::thread::hardware_concurrency()) {
+        size_t count = 0;
+        WatermarkEvent event;
+
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            throw_if_closed();
+            const size_t before = m_engine.size();
+            m_engine.push_bulk(first, last, std::max<size_t>(threads, 1));
+            count = m_engine.size() - before;
+            event = check_watermarks();
+        }
+
+        // Notify after unlock, waking as many consumers as there are new items
+        if (count == 1) {
+            m_readCondition.notify_one();
+            if (m_tokenWaiterCount.load()) {
+                std::lock_guard<std::mutex> lock(m_commMutex);
+                notify_token_one(WaitFor::NonEmpty);
+            }
+        } else if (count > 1)
+            notify_all_unlocked();
+
+        event.fire();
+    }
+
+    // Removes every element, returned in pop order
+    inline std::vector<T> drain(size_t threads = std::thread::hardware_concurrency()) {
+        std::vector<T> out;
+
+        // After close() only the unclaimed rest of the backlog is left
+        if (m_isClosed.load(std::memory_order_acquire)) {
+            take_drained(SIZE_MAX, out);
+            return out;
+        }
+
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            out = m_engine.drain_sorted(std::max<size_t>(threads, 1));
+            event = check_watermarks();
+        }
+
+        // The queue is empty now, which is the state wait_empty_push waits for
+        if (!out.empty())
+            notify_all_unlocked();
+
+        event.fire();
+
+        return out;
+    }
+
+    // Processes one round of a bulk-synchronous algorithm: inserts every element of
+    // `inserts`, then removes and returns the k best elements in pop order. Chunks of the
+    // batch are partially sorted in parallel while the calling thread pops the queue's own
+    // k best, the sorted candidates are merged, and everything not returned goes back in
+    // a single (parallel) bulk push.
+    inline std::vector<T> apply_batch(std::vector<T> inserts, size_t k, size_t threads = std::thread::hardware_concurrency()) {
+        constexpr size_t min_chunk = size_t(1) << 14;
+        threads = std::max<size_t>(threads, 1);
+
+        const size_t n = inserts.size();
+        const size_t chunks = std::max<size_t>(1, std::min(threads, n / min_chunk));
+
+        // Chunk c holds inserts[bounds[c], bounds[c + 1]), its sorted best prefix ends at heads[c]
+        std::vector<size_t> bounds(chunks + 1), heads(chunks);
+        for (size_t c = 0; c <= chunks; ++c)
+            bounds[c] = c * n / chunks;
+
+        auto select = [&](size_t c) {
+            const auto first = inserts.begin() + bounds[c], last = inserts.begin() + bounds[c + 1];
+            const auto mid = first + std::min<size_t>(k, size_t(last - first));
+
+            std::partial_sort(first, mid, last, Comp{});
+            heads[c] = size_t(mid - inserts.begin());
+        };
+
+        std::vector<T> out, queued;
+        out.reserve(k);
+        queued.reserve(k);
+        WatermarkEvent event;
+
+        {
+            // The chunk workers are started before the lock is taken, the calling thread then
+            // pops the queue's k best under it while they sort
+            std::unique_lock<std::mutex> lock(m_commMutex, std::defer_lock);
+            run_parallel(chunks, [&](size_t c) {
+                if (!c) {
+                    lock.lock();
+                    throw_if_closed();
+
+                    while (queued.size() < k && !m_engine.empty())
+                        queued.push_back(m_engine.pop());
+                }
+
+                select(c);
+            });
+
+            // Merge the chunk prefixes with the queue's best, queued elements win ties
+            std::vector<size_t> pos(bounds.begin(), bounds.end() - 1);
+            size_t queued_pos = 0;
+
+            while (out.size() < k) {
+                T* best = queued_pos < queued.size() ? &queued[queued_pos] : nullptr;
+                size_t best_chunk = chunks;
+
+                for (size_t c = 0; c < chunks; ++c)
+                    if (pos[c] < heads[c] && (!best || Comp{}(inserts[pos[c]], *best))) {
+                        best = &inserts[pos[c]];
+                        best_chunk = c;
+                    }
+
+                if (!best)
+                    break;
+
+                out.push_back(std::move(*best));
+                if (best_chunk == chunks)
+                    ++queued_pos;
+                else
+                    ++pos[best_chunk];
+            }
+
+            // Everything not returned goes back in one bulk push
+            std::vector<T> rest;
+            rest.reserve(n + queued.size() - out.size());
+            std::move(queued.begin() + queued_pos, queued.end(), std::back_inserter(rest));
+            for (size_t c = 0; c < chunks; ++c)
+                std::move(inserts.begin() + pos[c], inserts.begin() + bounds[c + 1], std::back_inserter(rest));
+
+            m_engine.push_bulk(std::make_move_iterator(rest.begin()), std::make_move_iterator(rest.end()), threads);
+            event = check_watermarks();
+        }
+
+        // Notify after unlock, the round may have both filled and emptied the queue
+        notify_all_unlocked();
+        event.fire();
+        return out;
+    }
+
+    // Threaded push/pop
+    inline void wait_empty_push(const T& item) { // Waits til empty
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        
+        // Wait until empty or done
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return m_engine.empty() || m_isDone;
+        });
+        --m_waiters;
+
+        if (m_isDone)
+            return;
+
+        throw_if_closed();
+        m_engine.push(item);
+        notify_one(WaitFor::NonEmpty);
+
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        event.fire();
+    }
+
+    inline void wait_empty_push(T&& item) { // Waits til empty
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        
+        // Wait until empty or done
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return m_engine.empty() || m_isDone;
+        });
+        --m_waiters;
+
+        if (m_isDone)
+            return;
+
+        throw_if_closed();
+        m_engine.push(std::move(item));
+        notify_one(WaitFor::NonEmpty);
+
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        event.fire();
+    }
+
+    template <typename... Args>
+    inline void wait_empty_push(Args&&... args) { // Waits til empty
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        
+        // Wait until empty or done
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return m_engine.empty() || m_isDone;
+        });
+        --m_waiters;
+
+        if (m_isDone)
+            return;
+
+        throw_if_closed();
+        m_engine.emplace(std::forward<Args>(args)...);
+        notify_one(WaitFor::NonEmpty);
+
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        event.fire();
+    }
+
+    inline std::optional<T> wait_nonempty_pop() { // Waits til non-empty
+        if (m_isClosed.load(std::memory_order_acquire))
+            return take_drained();
+
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        
+        // Wait until non-empty, done or closed
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return !m_engine.empty() || m_isDone || m_isClosed.load(std::memory_order_relaxed);
+        });
+        --m_waiters;
+
+        if (m_engine.empty()) {
+            lock.unlock();
+            return take_drained();
+        }
+
+        T temp = m_engine.pop();
+        
+        // Notify if the queue became empty, as this state is used by wait_empty_push
+        if (m_engine.empty())
+            notify_one(WaitFor::Empty);
+
+        const size_t shrink = shrink_request();
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        shrink_unlocked(shrink);
+        event.fire();
+
+        return std::make_optional<T>(std::move(temp));
+    }
+
+    // Waits til non-empty, then pops up to max elements in pop order under one lock. After
+    // close() batches are claimed from the sorted backlog without the lock. Empty when the
+    // queue is done (and empty) or drained.
+    inline std::vector<T> wait_pop_batch(size_t max) {
+        max = std::max<size_t>(max, 1);
+
+        if (!m_isClosed.load(std::memory_order_acquire)) {
+            std::unique_lock<std::mutex> lock(m_commMutex);
+
+            // Wait until non-empty, done or closed
+            ++m_waiters;
+            m_readCondition.wait(lock, [this] {
+                return !m_engine.empty() || m_isDone || m_isClosed.load(std::memory_order_relaxed);
+            });
+            --m_waiters;
+
+            if (!m_engine.empty())
+                return pop_batch_locked(lock, max);
+        }
+
+        std::vector<T> out;
+        take_drained(max, out);
+        return out;
+    }
+
+    // Drain-then-stop shutdown. Further pushes throw, and the remaining backlog is sorted
+    // once using up to `threads` threads into a buffer that pop(), wait_nonempty_pop() and
+    // wait_pop_batch() claim from in pop order without the lock, so shutdown takes about
+    // backlog / consumers. wait_drained() returns once all of it was handed out.
+    inline void close(size_t threads = std::thread::hardware_concurrency()) {
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            if (m_isClosed.load(std::memory_order_relaxed))
+                return;
+
+            m_drained = m_engine.drain_sorted(std::max<size_t>(threads, 1));
+            m_drainCursor.store(0);
+            m_drainTaken.store(0);
+            m_isClosed.store(true, std::memory_order_release);
+
+            // Releases throttled producers, their next push reports the closed queue
+            event = check_watermarks();
+        }
+
+        // Notify after unlock, consumers switch to the drain buffer and wait_empty_push throws
+        notify_all_unlocked();
+        event.fire();
+    }
+
+    // Waits until the queue is closed and every element of its backlog was popped
+    inline void wait_drained() {
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return m_isClosed.load(std::memory_order_relaxed) && m_drainTaken.load() == m_drained.size();
+        });
+        --m_waiters;
+    }
+
+    inline bool is_closed() const noexcept {
+        return m_isClosed.load();
+    }
+
+    // Registers soft flow control thresholds, replacing earlier ones. The throttled state is
+    // re-evaluated against the current size, firing a callback if it changes. Pass
+    // Watermarks() to remove them.
+    inline void set_watermarks(Watermarks marks) {
+        if (marks.low >= marks.high)
+            throw std::invalid_argument("low watermark must be below the high watermark.");
+
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_highWatermark = marks.high;
+            m_lowWatermark = marks.low;
+            m_watermarks = std::make_shared<const Watermarks>(std::move(marks));
+
+            const bool throttled = m_engine.size() >= m_highWatermark;
+            if (throttled != m_isThrottled.load(std::memory_order_relaxed)) {
+                m_isThrottled.store(throttled);
+                event = WatermarkEvent{m_watermarks, throttled, ++m_watermarkSeq, this};
+            }
+        }
+
+        event.fire();
+    }
+
+    // Whether size() last crossed the high watermark rather than the low one. Producers
+    // can poll this instead of registering callbacks.
+    inline bool is_throttled() const noexcept {
+        return m_isThrottled.load(std::memory_order_relaxed);
+    }
+
+#if defined(__cpp_lib_jthread)
+    // Cancellable waits. A stop request wakes only the waiter holding that token, which
+    // then returns false / nullopt. Elements are still pushed or popped when the awaited
+    // state arrives first.
+    inline bool wait_empty_push(std::stop_token token, const T& item) { // Waits til empty
+        return wait_empty_emplace(std::move(token), item);
+    }
+
+    inline bool wait_empty_push(std::stop_token token, T&& item) { // Waits til empty
+        return wait_empty_emplace(std::move(token), std::move(item));
+    }
+
+    template <typename... Args>
+    inline bool wait_empty_push(std::stop_token token, Args&&... args) { // Waits til empty
+        return wait_empty_emplace(std::move(token), std::forward<Args>(args)...);
+    }
+
+    inline std::optional<T> wait_nonempty_pop(std::stop_token token) { // Waits til non-empty
+        if (m_isClosed.load(std::memory_order_acquire))
+            return take_drained();
+
+        // Declared before the lock, so the callback is unregistered after unlocking
+        TokenWaiter waiter(WaitFor::NonEmpty);
+        std::stop_callback wake(token, [this, &waiter] {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            waiter.cv.notify_one();
+        });
+
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        wait_token(lock, token, waiter, [this] {
+            return !m_engine.empty() || m_isDone || m_isClosed.load(std::memory_order_relaxed);
+        });
+
+        if (m_engine.empty()) {
+            lock.unlock();
+            return token.stop_requested() ? std::nullopt : take_drained();
+        }
+
+        T temp = m_engine.pop();
+
+        // Notify if the queue became empty, as this state is used by wait_empty_push
+        if (m_engine.empty())
+            notify_one(WaitFor::Empty);
+
+        const size_t shrink = shrink_request();
+        const WatermarkEvent event = check_watermarks();
+        lock.unlock();
+        shrink_unlocked(shrink);
+        event.fire();
+
+        return std::make_optional<T>(std::move(temp));
+    }
+
+    inline std::optional<T> wait_and_get_top(std::stop_token token) const {
+        TokenWaiter waiter(WaitFor::NonEmpty);
+        std::stop_callback wake(token, [this, &waiter] {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            waiter.cv.notify_one();
+        });
+
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        wait_token(lock, token, waiter, [this] {
+            return !m_engine.empty() || m_isDone || m_isClosed.load(std::memory_order_relaxed);
+        });
+
+        if (m_engine.empty()) {
+            lock.unlock();
+            return token.stop_requested() ? std::nullopt : drained_top();
+        }
+
+        return std::make_optional<T>(m_engine.top());
+    }
+
+    inline std::vector<T> wait_pop_batch(std::stop_token token, size_t max) {
+        max = std::max<size_t>(max, 1);
+
+        if (!m_isClosed.load(std::memory_order_acquire)) {
+            TokenWaiter waiter(WaitFor::NonEmpty);
+            std::stop_callback wake(token, [this, &waiter] {
+                std::lock_guard<std::mutex> lock(m_commMutex);
+                waiter.cv.notify_one();
+            });
+
+            std::unique_lock<std::mutex> lock(m_commMutex);
+            wait_token(lock, token, waiter, [this] {
+                return !m_engine.empty() || m_isDone || m_isClosed.load(std::memory_order_relaxed);
+            });
+
+            if (!m_engine.empty())
+                return pop_batch_locked(lock, max);
+            if (token.stop_requested())
+                return {};
+        }
+
+        std::vector<T> out;
+        take_drained(max, out);
+        return out;
+    }
+
+    // Returns false if stopped before the backlog was drained
+    inline bool wait_drained(std::stop_token token) {
+        TokenWaiter waiter(WaitFor::Drained);
+        std::stop_callback wake(token, [this, &waiter] {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            waiter.cv.notify_one();
+        });
+
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        return wait_token(lock, token, waiter, [this] {
+            return m_isClosed.load(std::memory_order_relaxed) && m_drainTaken.load() == m_drained.size();
+        });
+    }
+#endif
+
+    // Recycle channel. Consumers hand processed elements back with recycle() (or let a
+    // Recycled handle do it) and producers acquire() them to fill in place of a fresh
+    // allocation. Lock-free, independent of m_commMutex.
+    inline Recycled pop_with_recycle() { // Waits til non-empty
+        std::optional<T> temp = wait_nonempty_pop();
+        if (!temp)
+            return Recycled();
+
+        return Recycled(std::move(*temp), &recycle_pool());
+    }
+
+    // Returns false (and drops item) when the pool is full
+    inline bool recycle(T&& item) {
+        return recycle_pool().put(std::move(item));
+    }
+
+    // A previously recycled element, nullopt when none is spare
+    inline std::optional<T> acquire() {
+        return recycle_pool().take();
+    }
+
+    // Sets the pool size, only effective before the first recycle()/acquire()
+    inline void reserve_recycle(size_t capacity) {
+        recycle_pool(capacity);
+    }
+
+    // Strictly nonthreaded push/pop (unsafe)
+    inline void unsafe_push(const T& item) {
+        m_engine.push(item);
+        m_readCondition.notify_one();
+    }
+
+    inline void unsafe_push(T&& item) {
+        m_engine.push(std::move(item));
+        m_readCondition.notify_one();
+    }
+
+    template <typename... Args>
+    inline void unsafe_push(Args&&... args) {
+        m_engine.emplace(std::forward<Args>(args)...);
+        m_readCondition.notify_one();
+    }
+
+    inline T unsafe_pop() {
+        if (m_engine.empty())
+            throw std::runtime_error("pop() attempted on empty priority queue.");
+
+        T temp = m_engine.pop();
+        
+        // Notify if the queue became empty, as this state is used by wait_empty_push
+        if (m_engine.empty())
+            m_readCondition.notify_one();
+        
+        return temp;
+    }
+
+    // Strict getters
+    // The backlog of a closed queue is moved out by concurrent pops, so no reference into
+    // it is handed out. wait_and_get_top() returns a copy of its top instead.
+    inline const T& top() const {
+        std::lock_guard<std::mutex> lock(m_commMutex);
+        if (m_isClosed.load(std::memory_order_relaxed))
+            throw std::runtime_error("top() attempted on closed priority queue, use wait_and_get_top().");
+        if (m_engine.empty())
+            throw std::runtime_error("top() attempted on empty priority queue.");
+
+        return m_engine.top();
+    }
+
+    inline size_t size() const noexcept {
+        if (m_isClosed.load(std::memory_order_acquire)) // Unclaimed part of the backlog
+            return m_drained.size() - std::min(m_drainCursor.load(), m_drained.size());
+
+        return m_engine.size();
+    }
+
+    inline bool empty() const noexcept {
+        return !size();
+    }
+
+    // Bytes held by the engine's storage (array-backed engines)
+    inline size_t memory_usage() const {
+        std::lock_guard<std::mutex> lock(m_commMutex);
+        return m_engine.memory_usage();
+    }
+
+    // Engine specific statistics and settings. Like size(), reads are not synchronized.
+    inline const Engine& engine() const noexcept {
+        return m_engine;
+    }
+
+    // Threaded getters
+    inline std::optional<T> wait_and_get_top() const {
+        std::unique_lock<std::mutex> lock(m_commMutex);
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return !m_engine.empty() || m_isDone || m_isClosed.load(std::memory_order_relaxed);
+        });
+        --m_waiters;
+
+        if (m_engine.empty()) {
+            lock.unlock();
+            return drained_top();
+        }
+
+        return std::make_optional<T>(m_engine.top());
+    }
+
+    // Done function
+    inline void done() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_isDone = true;
+        }
+
+        // Notify after unlock
+        notify_all_unlocked();
+    }
+
+    inline bool is_done() const noexcept {
+        return m_isDone;
+    }
+
+    // Clears the done and closed flags so the queue can be reused for another phase. An
+    // unclaimed rest of a closed queue's backlog is pushed back. Throws std::logic_error
+    // while threads wait on the queue or pop from a closed one.
+    inline void reopen() {
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            if (throw_if_busy("reopen() attempted while threads use the priority queue.")) {
+                const size_t first = std::min(m_drainCursor.load(), m_drained.size());
+                try {
+                    m_engine.push_bulk(std::make_move_iterator(m_drained.begin() + first), std::make_move_iterator(m_drained.end()), 1);
+                } catch (...) {
+                    reset_drain(); // Partly moved from, the queue stays open with what the engine holds
+                    throw;
+                }
+                reset_drain();
+                event = check_watermarks();
+            }
+
+            m_isDone = false;
+        }
+
+        notify_all_unlocked();
+        event.fire();
+    }
+
+    // Destroys every element while keeping the engine's storage, then reopens the queue.
+    // Throws std::logic_error while threads wait on the queue or pop from a closed one.
+    inline void reset() {
+        WatermarkEvent event;
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            throw_if_busy("reset() attempted while threads use the priority queue.");
+
+            if constexpr (engine_clears<Engine>::value)
+                m_engine.clear();
+            else
+                m_engine.drain_sorted(1);
+
+            reset_drain();
+            m_isDone = false;
+            event = check_watermarks();
+        }
+
+        // The queue is empty now, which is the state wait_empty_push waits for
+        notify_all_unlocked();
+        event.fire();
     }
 };
 
@@ -0,0 +1,306 @@
+#ifndef TWO_LEVEL_QUEUE_H
+#define TWO_LEVEL_QUEUE_H
+
+#include "threaded_priority_queue.h"
+
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+#include <optional>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+// Two-level priority queue for push-heavy workloads. Every thread pushes into its own local
+// BinaryHeap under a per-local mutex, and a small global heap holds a copy of each local
+// heap's current top. A pop takes the global best, pops the owning local heap and refills
+// that local's global entry. Producers only touch the global lock when they push a new
+// local top.
+//
+// Ordering is exact except while a push that produced a new local top has not yet updated
+// the global heap; a concurrent pop in that window may take the previous best instead.
+//
+// Not an engine: engines run under ThreadedPriorityQueue's single mutex, which would
+// serialize the per-local locks. The interface mirrors ThreadedPriorityQueue, except that
+// wait_empty_push() is best effort: it is atomic against other wait_empty_push() calls,
+// but a plain push() only takes its local lock and may land between the emptiness check
+// and the push.
+template <typename T, typename Comp = std::less<T>>
+class TwoLevelPriorityQueue {
+    struct alignas(64) Local {
+        std::mutex mutex;
+        BinaryHeap<T, Comp> heap;
+        size_t index = 0;
+    };
+
+    struct Entry {
+        T top;
+        size_t local;
+    };
+
+    static constexpr size_t npos = size_t(-1);
+    static inline std::atomic<size_t> s_nextThread{0};
+
+    std::vector<std::unique_ptr<Local>> m_locals;
+
+    // Indexed heap of local tops, guarded by m_commMutex
+    std::vector<Entry> m_global;
+    std::vector<size_t> m_position; // Local -> index in m_global, npos when the local is empty
+
+    std::condition_variable m_readCondition;
+    mutable std::mutex m_commMutex;
+    std::atomic<size_t> m_size{0};
+    size_t m_waiters = 0; // Threads sleeping on m_readCondition, guarded by m_commMutex
+    bool m_isDone = false;
+
+    inline Local& local_for_thread() noexcept {
+        static thread_local const size_t thread = s_nextThread.fetch_add(1);
+        return *m_locals[thread % m_locals.size()];
+    }
+
+    inline void swap_entries(size_t a, size_t b) noexcept {
+        std::swap(m_global[a], m_global[b]);
+        m_position[m_global[a].local] = a;
+        m_position[m_global[b].local] = b;
+    }
+
+    inline void percolate_up(size_t index) noexcept {
+        while (index > 0) {
+            const size_t parent_index = (index - 1) / 2;
+            if (!Comp{}(m_global[index].top, m_global[parent_index].top))
+                break;
+
+            swap_entries(index, parent_index);
+            index = parent_index;
+        }
+    }
+
+    inline void percolate_down(size_t index) noexcept {
+        const size_t n = m_global.size();
+
+        while (2 * index + 1 < n) {
+            const size_t left_child = 2 * index + 1;
+            const size_t right_child = 2 * index + 2;
+
+            size_t largest_index = index;
+            if (Comp{}(m_global[left_child].top, m_global[largest_index].top))
+                largest_index = left_child;
+
+            if (right_child < n && Comp{}(m_global[right_child].top, m_global[largest_index].top))
+                largest_index = right_child;
+
+            if (largest_index == index)
+                break;
+
+            swap_entries(index, largest_index);
+            index = largest_index;
+        }
+    }
+
+    // Syncs a local's global entry with its heap. Caller holds m_commMutex and the local's mutex.
+    inline void update_entry(size_t local) {
+        const BinaryHeap<T, Comp>& heap = m_locals[local]->heap;
+        size_t index = m_position[local];
+
+        if (heap.empty()) {
+            if (index == npos)
+                return;
+
+            const size_t last = m_global.size() - 1;
+            if (index != last)
+                swap_entries(index, last);
+
+            m_global.pop_back();
+            m_position[local] = npos;
+
+            if (index < m_global.size()) {
+                percolate_up(index);
+                percolate_down(index);
+            }
+            return;
+        }
+
+        if (index == npos) {
+            m_global.push_back(Entry{heap.top(), local});
+            index = m_global.size() - 1;
+            m_position[local] = index;
+        } else
+            m_global[index].top = heap.top();
+
+        percolate_up(index);
+        percolate_down(m_position[local]);
+    }
+
+    // Pushes into the thread's local heap and publishes its top, m_commMutex held.
+    // Returns whether sleepers have to be woken.
+    inline bool push_locked(T&& item) {
+        Local& local = local_for_thread();
+
+        std::lock_guard<std::mutex> lock(local.mutex);
+        local.heap.push(std::move(item));
+        m_size.fetch_add(1);
+        update_entry(local.index);
+
+        return m_waiters;
+    }
+
+    inline void push_local(T&& item) {
+        Local& local = local_for_thread();
+        bool new_top;
+
+        {
+            std::lock_guard<std::mutex> lock(local.mutex);
+            new_top = local.heap.empty() || Comp{}(item, local.heap.top());
+            local.heap.push(std::move(item));
+            m_size.fetch_add(1);
+        }
+
+        // Only a new local top has to be published to the global heap. A push behind the
+        // current top leaves m_global as it is: its local is either listed already or about
+        // to be published by the push that made that top.
+        if (!new_top)
+            return;
+
+        bool wake;
+        {
+            std::lock_guard<std::mutex> global_lock(m_commMutex);
+            std::lock_guard<std::mutex> lock(local.mutex);
+            update_entry(local.index);
+            wake = m_waiters;
+        }
+
+        // Publishing is the only way m_global turns non-empty, so every sleeper is woken
+        // here; with notify_one a push behind the top could be left with nobody awake
+        if (wake)
+            m_readCondition.notify_all();
+    }
+
+    inline T pop_best() {
+        const size_t local = m_global[0].local;
+        Local& owner = *m_locals[local];
+
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        T temp = owner.heap.pop();
+        update_entry(local);
+
+        // Notify if the queue became empty, as this state is used by wait_empty_push
+        if (m_size.fetch_sub(1) == 1)
+            m_readCondition.notify_all();
+
+        return temp;
+    }
+public:
+    explicit TwoLevelPriorityQueue(size_t locals = std::thread::hardware_concurrency()) {
+        locals = std::max<size_t>(locals, 1);
+        for (size_t i = 0; i < locals; ++i) {
+            m_locals.push_back(std::make_unique<Local>());
+            m_locals.back()->index = i;
+        }
+
+        m_position.assign(locals, npos);
+        m_global.reserve(locals);
+    }
+
+    TwoLevelPriorityQueue(const TwoLevelPriorityQueue&) = delete;
+    TwoLevelPriorityQueue& operator=(const TwoLevelPriorityQueue&) = delete;
+
+    // Push and pop
+    inline void push(const T& item) {
+        push_local(T(item));
+    }
+
+    inline void push(T&& item) {
+        push_local(std::move(item));
+    }
+
+    template <typename... Args>
+    inline void push(Args&&... args) {
+        push_local(T(std::forward<Args>(args)...));
+    }
+
+    inline T pop() {
+        std::lock_guard<std::mutex> lock(m_commMutex);
+        if (m_global.empty())
+            throw std::runtime_error("pop() attempted on empty priority queue.");
+
+        return pop_best();
+    }
+
+    // Threaded push/pop
+    inline void wait_empty_push(T item) { // Waits til empty
+        std::unique_lock<std::mutex> lock(m_commMutex);
+
+        // Wait until empty or done
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return !m_size.load() || m_isDone;
+        });
+        --m_waiters;
+
+        if (m_isDone)
+            return;
+
+        // Pushed before unlocking, so no other wait_empty_push() can slip in between
+        const bool wake = push_locked(std::move(item));
+        lock.unlock();
+
+        if (wake)
+            m_readCondition.notify_all();
+    }
+
+    inline std::optional<T> wait_nonempty_pop() { // Waits til non-empty
+        std::unique_lock<std::mutex> lock(m_commMutex);
+
+        // Wait until non-empty or done
+        ++m_waiters;
+        m_readCondition.wait(lock, [this] {
+            return !m_global.empty() || m_isDone;
+        });
+        --m_waiters;
+
+        if (m_global.empty())
+            return std::nullopt;
+
+        return std::make_optional<T>(pop_best());
+    }
+
+    // Strict getters
+    inline T top() const {
+        std::lock_guard<std::mutex> lock(m_commMutex);
+        if (m_global.empty())
+            throw std::runtime_error("top() attempted on empty priority queue.");
+
+        return m_global[0].top;
+    }
+
+    inline size_t size() const noexcept {
+        return m_size.load();
+    }
+
+    inline bool empty() const noexcept {
+        return !m_size.load();
+    }
+
+    inline size_t locals() const noexcept {
+        return m_locals.size();
+    }
+
+    // Done function
+    inline void done() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_commMutex);
+            m_isDone = true;
+        }
+
+        // Notify after unlock
+        m_readCondition.notify_all();
+    }
+
+    inline bool is_done() const noexcept {
+        return m_isDone;
+    }
+};
+
+#endif // TWO_LEVEL_QUEUE_H